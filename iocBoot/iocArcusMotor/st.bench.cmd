@@ -0,0 +1,45 @@
+# Benchmark the driver against the controller simulator, no motor records.
+# Start the simulators first, one per controller type:
+#    arcusSim -m pmx -p 5001
+#    arcusSim -m eth -p 5002
+#    arcusSim -m ksa -p 5003 -n 4
+# Add -l/-j to give them realistic reply latency (ms), e.g. -l 1 -j 0.5.
+epicsEnvSet("TOP","/home/rwheat/epics/modules/motorR6-8")
+epicsEnvSet("MOTOR","/home/rwheat/epics/modules/motorR6-8")
+dbLoadDatabase("../../dbd/ArcusMotor.dbd")
+ArcusMotor_registerRecordDeviceDriver(pdbbase)
+
+drvAsynIPPortConfigure("PMX","127.0.0.1:5001",0,0,0)
+drvAsynIPPortConfigure("ETH","127.0.0.1:5002",0,0,0)
+drvAsynIPPortConfigure("KSA","127.0.0.1:5003",0,0,0)
+asynOctetSetInputEos("KSA",0,"\r")
+asynOctetSetOutputEos("KSA",0,"\r")
+
+# Idle poll period long, so the poller stays out of the way of the benchmark.
+arcusCreateController("P0", "PMX", 4, 0.050, 10.0, 0)
+arcusCreateController("P1", "ETH", 1, 0.050, 10.0, 0)
+arcusCreateController("P2", "KSA", 4, 0.050, 10.0, 1)
+
+arcusCreateAxis("P0", 0, 0);
+arcusCreateAxis("P0", 1, 1);
+arcusCreateAxis("P0", 2, 2);
+arcusCreateAxis("P0", 3, 3);
+arcusCreateAxis("P1", 0, 0);
+arcusCreateAxis("P2", 0, 0);
+arcusCreateAxis("P2", 1, 1);
+arcusCreateAxis("P2", 2, 2);
+arcusCreateAxis("P2", 3, 3);
+
+iocInit()
+
+# Controller port, axes polled per cycle, iterations, move distance (steps),
+# velocity (steps/s)
+# arcusBenchmark(const char *motorPortName, int nAxes, int iterations,
+#                int distance, int velocity)
+arcusBenchmark("P0", 1, 100, 1000, 5000)
+arcusBenchmark("P0", 4, 100, 1000, 5000)
+arcusBenchmark("P1", 1, 100, 1000, 5000)
+arcusBenchmark("P2", 1, 100, 1000, 5000)
+arcusBenchmark("P2", 2, 100, 1000, 5000)
+arcusBenchmark("P2", 4, 100, 1000, 5000)
+arcusParserBench(1000000)
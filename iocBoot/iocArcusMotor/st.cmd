@@ -7,6 +7,12 @@ ArcusMotor_registerRecordDeviceDriver(pdbbase)
 ### Motors
 # Motors substitutions, customize this for your motor
 dbLoadTemplate "motor.substitutions"
+# Controller statistics (command counts, latency histograms, retries)
+#dbLoadTemplate "arcusStats.substitutions"
+# Latch input capture (arm, captures, latched positions)
+#dbLoadTemplate "arcusLatch.substitutions"
+# Poll history (time, encoder, position and status of the last 1024 polls)
+#dbLoadTemplate "arcusSamples.substitutions"
 
 # Configure the port
 # drvAsynIPPortConfigure("Ether","127.0.0.1:5001",0,0,0)
@@ -15,7 +21,10 @@ dbLoadTemplate "motor.substitutions"
 # drvAsynIPPortConfigure("Ether","172.18.4.103:5001",0,0,0)
 
 # For the DMX-ETH that I have, there's no EOS, so, set the noProcessEosIn flag
-# to '1' to keep from timing out with every read.
+# to '1' to keep from timing out with every read. The driver finds the end of
+# each reply itself (NUL from the Ethernet controllers, CR from the DMX-K-SA,
+# or a short quiet gap when the DMX-ETH sends no terminator at all), so reads
+# complete as soon as the reply is in.
 # drvAsynIPPortConfigure("Ether","172.18.4.250:5001",0,0,1)
 
 # For the DMX-K-SA-17/23 on RS-232, using my USB to Serial adapter.
@@ -38,14 +47,35 @@ asynOctetSetOutputEos("Ether",0,"\r")
 
 # var drvArcusMotordebug 4
 
-# Controller port, asyn port, number of axis, moving poll period, idle poll period, Arcus Controller Flag (0=Normal, 1=RS-485 Style)
-# arcusCreateController(const char *motorPortName, const char *ioPortName, int numAxes, double movingPollPeriod, double idlePollPeriod);
+# To probe all the controllers below at the same time rather than one after
+# the other (they are all done before iocInit gets to the device support)...
+# arcusSetDeferredInit(1)
+
+# Controller port, asyn port, number of axis, moving poll period, idle poll period, Arcus Controller Flag (0=Normal, 1=RS-485 Style),
+# max baud rate (DMX-K-SA on a serial port only, 0=leave as is), store baud rate in the drives (0=no, 1=yes),
+# model (PMX, DMX-ETH or DMX-K-SA; empty to ask the controller)
+# arcusCreateController(const char *motorPortName, const char *ioPortName, int numAxes, double movingPollPeriod, double idlePollPeriod,
+#                       int ArcusControllerFlag, int maxBaud, int storeBaud, const char *model);
 arcusCreateController("P0", "Ether", 1, 0.050, 2.0, 1)
+# To run the DMX-K-SA line at the fastest rate the drives support...
+# arcusCreateController("P0", "Ether", 1, 0.050, 2.0, 1, 115200, 0)
+# To skip the model identification at boot...
+# arcusCreateController("P0", "Ether", 1, 0.050, 2.0, 1, 0, 0, "DMX-K-SA")
 
 # Controller port, axis letter, controller channel
 # arcusCreateAxis(const char *motorPortName, int axisNumber, int channel)
 # arcusCreateAxis("P0", 0, 1);
 arcusCreateAxis("P0", 0, 0);
 
+# Profile moves of up to 2000 points, streamed from the IOC. Load the motor
+# module's profileMoveController.template and profileMoveAxis.template for them.
+# arcusCreateProfile(const char *motorPortName, int maxPoints)
+# arcusCreateProfile("P0", 2000)
+
+# Share the controller with engineering tools through 127.0.0.1:5002; status
+# queries are answered from replies up to 0.1 s old.
+# arcusProxyStart(const char *motorPortName, int tcpPort, double cacheAge)
+# arcusProxyStart("P0", 5002, 0.1)
+
 iocInit()
 
@@ -0,0 +1,435 @@
+/* ex: set shiftwidth=3 tabstop=3 expandtab: */
+
+/*************************************************************************\
+* Copyright (c) 2015, Triad National Security, LLC.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* Benchmarks for the Arcus motor driver, run from the IOC shell.            */
+/*                                                                            */
+/* arcusParserBench compares the reply parser, arcusParseInts(), with the     */
+/* sscanf() calls it replaced, and shows how each handles malformed replies.  */
+/*                                                                            */
+/* arcusBenchmark drives a configured controller (real, or arcusSim, see      */
+/* iocBoot/iocArcusMotor/st.bench.cmd) through poll cycles, moves and stops,  */
+/* and reports the commands and round trips each takes and their latency.     */
+
+#include <iocsh.h>
+
+#include <asynMotorController.h>
+#include <asynMotorAxis.h>
+#include <arcusMotorDriver.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsExport.h>
+
+#define DEFLT_PARSE_ITERATIONS 1000000
+#define DEFLT_BENCH_ITERATIONS 100
+#define DEFLT_BENCH_DISTANCE   1000
+#define DEFLT_BENCH_VELOCITY   5000
+#define BENCH_ACCEL            50      /* ms                                  */
+#define BENCH_DONE_TIMEOUT     30.0    /* Give up waiting for done (s).       */
+#define BENCH_JOG_TIME         0.1     /* Jog this long before stopping (s).  */
+
+/* Replies as the controllers send them, terminator already stripped.         */
+static const struct {
+   const char *rep;
+   int        nVals;
+} arcusGoodReplies[] = {
+   {"1234:-56:0:2147483647", 4},   /* PMX-4ET-SA PE/PP                        */
+   {"0:0:0:0",               4},   /* PMX-4ET-SA MST                          */
+   {"-1048576",              1},   /* DMX EX/PX                               */
+   {"3",                     1}    /* DMX MST                                 */
+};
+#define NUM_GOOD_REPLIES \
+   (int)(sizeof(arcusGoodReplies) / sizeof(arcusGoodReplies[0]))
+
+static const struct {
+   const char *rep;
+   int        nVals;
+} arcusBadReplies[] = {
+   {"",                      1},
+   {"?BAD COMMAND",          1},
+   {"12:34",                 4},
+   {"12:34:",                4},
+   {"12;34:56:78",           4},
+   {"12:34:56:78:90",        4},
+   {"9999999999",            1},
+   {"12abc",                 1},
+   {"-",                     1}
+};
+#define NUM_BAD_REPLIES \
+   (int)(sizeof(arcusBadReplies) / sizeof(arcusBadReplies[0]))
+
+/* The parsing done before arcusParseInts(), kept here for comparison.        */
+static int arcusScanfParse(const char *rep, int *vals, int nVals)
+{
+   if(nVals == 4)
+      return(sscanf(rep, "%d:%d:%d:%d", &vals[0], &vals[1], &vals[2],
+                    &vals[3]) == 4);
+   return(sscanf(rep, "%d", &vals[0]) == 1);
+}
+
+static double arcusBenchSeconds(const epicsTimeStamp *start)
+{
+   epicsTimeStamp now;
+
+   epicsTimeGetCurrent(&now);
+   return(epicsTimeDiffInSeconds(&now, start));
+}
+
+/* arcusParserBench(iterations)                                               */
+extern "C" int arcusParserBench(int iterations)
+{
+   epicsTimeStamp start;
+   double         tScanf, tParse;
+   size_t         lens[NUM_GOOD_REPLIES];
+   int            vals[4];
+   int            sum = 0;
+   int            i, j;
+
+   if(iterations <= 0)
+      iterations = DEFLT_PARSE_ITERATIONS;
+   for(j = 0; j < NUM_GOOD_REPLIES; j++)
+      lens[j] = strlen(arcusGoodReplies[j].rep);
+
+   epicsTimeGetCurrent(&start);
+   for(i = 0; i < iterations; i++)
+      for(j = 0; j < NUM_GOOD_REPLIES; j++)
+         if(arcusScanfParse(arcusGoodReplies[j].rep, vals,
+               arcusGoodReplies[j].nVals))
+            sum += vals[0];
+   tScanf = arcusBenchSeconds(&start);
+
+   epicsTimeGetCurrent(&start);
+   for(i = 0; i < iterations; i++)
+      for(j = 0; j < NUM_GOOD_REPLIES; j++)
+         if(arcusParseInts(arcusGoodReplies[j].rep, lens[j], vals,
+               arcusGoodReplies[j].nVals) == PARSE_OK)
+            sum += vals[0];
+   tParse = arcusBenchSeconds(&start);
+
+   printf("arcusParserBench: %d replies each (checksum %d)\n",
+      iterations * NUM_GOOD_REPLIES, sum);
+   printf("  sscanf          %8.1f ns/reply\n",
+      tScanf * 1e9 / ((double)iterations * NUM_GOOD_REPLIES));
+   printf("  arcusParseInts  %8.1f ns/reply\n",
+      tParse * 1e9 / ((double)iterations * NUM_GOOD_REPLIES));
+
+   printf("  %-18s %-8s %s\n", "malformed reply", "sscanf", "arcusParseInts");
+   for(j = 0; j < NUM_BAD_REPLIES; j++)
+   {
+      printf("  %-18s %-8s %s\n", arcusBadReplies[j].rep,
+         arcusScanfParse(arcusBadReplies[j].rep, vals,
+            arcusBadReplies[j].nVals) ? "accepted" : "rejected",
+         arcusParseStatusStrings[arcusParseInts(arcusBadReplies[j].rep,
+            strlen(arcusBadReplies[j].rep), vals,
+            arcusBadReplies[j].nVals)]);
+   }
+
+   return(0);
+}
+
+/* Samples of one measured operation.                                        */
+typedef struct arcusBenchStat {
+   const char    *name;
+   double        *t;          /* Wall time of each sample (s).                */
+   int           n;
+   double        cpu;         /* Total CPU time (s).                          */
+   unsigned long cmds;        /* Total commands written.                      */
+   unsigned long roundTrips;  /* Total line turnarounds.                      */
+   int           errors;
+} arcusBenchStat;
+
+static int arcusBenchCompare(const void *a, const void *b)
+{
+   double d = *(const double *)a - *(const double *)b;
+
+   return((d < 0.0) ? -1 : (d > 0.0) ? 1 : 0);
+}
+
+static void arcusBenchReport(arcusBenchStat *st)
+{
+   double n = st->n;
+
+   if(st->n == 0)
+   {
+      printf("  %-13s no samples, %d errors\n", st->name, st->errors);
+      return;
+   }
+   qsort(st->t, st->n, sizeof(double), arcusBenchCompare);
+   printf("  %-13s %6d %7.2f %7.2f %9.3f %9.3f %9.3f %6d\n", st->name, st->n,
+      st->cmds / n, st->roundTrips / n, st->t[(st->n - 1) / 2] * 1e3,
+      st->t[(int)ceil(0.99 * n) - 1] * 1e3, st->cpu * 1e6 / n, st->errors);
+}
+
+/* CPU time (s) of the calling thread where the OS can tell, otherwise of     */
+/* the whole process, I/O thread and the rest of the IOC included.            */
+#ifdef CLOCK_THREAD_CPUTIME_ID
+#define BENCH_CPU_LABEL "thread"
+static double arcusBenchCpu()
+{
+   struct timespec ts;
+
+   if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+      return(0.0);
+   return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+#else
+#define BENCH_CPU_LABEL "process"
+static double arcusBenchCpu()
+{
+   return((double)clock() / CLOCKS_PER_SEC);
+}
+#endif
+
+/* Bracket one operation: counters and clocks before, samples after.          */
+typedef struct arcusBenchMark {
+   epicsTimeStamp wall;
+   double         cpu;
+   unsigned long  cmds;
+   unsigned long  roundTrips;
+} arcusBenchMark;
+
+static void arcusBenchStart(arcusController *pC, arcusBenchMark *m)
+{
+   pC->getTraffic(&m->cmds, &m->roundTrips);
+   m->cpu = arcusBenchCpu();
+   epicsTimeGetCurrent(&m->wall);
+}
+
+static void arcusBenchEnd(arcusController *pC, arcusBenchMark *m,
+                          arcusBenchStat *st, asynStatus status)
+{
+   unsigned long cmds, roundTrips;
+   double        t = arcusBenchSeconds(&m->wall);
+
+   st->cpu += arcusBenchCpu() - m->cpu;
+   pC->getTraffic(&cmds, &roundTrips);
+   st->cmds       += cmds - m->cmds;
+   st->roundTrips += roundTrips - m->roundTrips;
+   if(status == asynSuccess)
+      st->t[st->n++] = t;
+   else
+      st->errors++;
+}
+
+/* One poll cycle the way the poller runs it: the controller, then each axis. */
+/* poll() takes this thread for the poller; give the real one its role back  */
+/* so that its queries go on yielding the lock to stops.                     */
+static asynStatus arcusBenchPoll(arcusController *pC, int nAxes, bool *moving)
+{
+   epicsThreadId poller = pC->pollerThread();
+   asynStatus    status, axisStatus;
+   bool          axisMoving;
+   int           i;
+
+   *moving = false;
+   status = pC->poll();
+   for(i = 0; i < nAxes; i++)
+   {
+      axisStatus = pC->getAxis(i)->poll(&axisMoving);
+      if(axisStatus != asynSuccess)
+         status = axisStatus;
+      if(axisMoving && (i == 0))
+         *moving = true;
+   }
+   pC->setPollerThread(poller);
+   return(status);
+}
+
+/* Poll (under the controller lock, as the poller does) until axis 0 is done. */
+/* Returns the time from start until done was seen, or -1 on a timeout.       */
+static double arcusBenchWaitDone(arcusController *pC, int nAxes,
+                                 const epicsTimeStamp *start)
+{
+   bool   moving = true;
+
+   while(moving)
+   {
+      if(arcusBenchSeconds(start) > BENCH_DONE_TIMEOUT)
+         return(-1.0);
+      pC->lock();
+      arcusBenchPoll(pC, nAxes, &moving);
+      pC->unlock();
+   }
+   return(arcusBenchSeconds(start));
+}
+
+/* arcusBenchmark(port, nAxes, iterations, distance, velocity)                */
+extern "C" int arcusBenchmark(const char *controllerPortName, int nAxes,
+   int iterations, int distance, int velocity)
+{
+   arcusController *pC;
+   arcusAxis       *pAxis;
+   arcusBenchStat  st[5];
+   arcusBenchMark  m;
+   asynStatus      status;
+   epicsTimeStamp  start;
+   bool            moving;
+   double          t, predicted;
+   int             i, k, dir = 1;
+
+   pC = (arcusController*)findAsynPortDriver(controllerPortName);
+   if(!pC)
+   {
+		printf("arcusBenchmark: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   if(nAxes <= 0)
+      nAxes = 1;
+   for(i = 0; i < nAxes; i++)
+      if(!pC->getAxis(i))
+      {
+         printf("arcusBenchmark: port %s has no axis %d\n",
+            controllerPortName, i);
+         return(asynError);
+      }
+   if(iterations <= 0)
+      iterations = DEFLT_BENCH_ITERATIONS;
+   if(distance <= 0)
+      distance = DEFLT_BENCH_DISTANCE;
+   if(velocity <= 0)
+      velocity = DEFLT_BENCH_VELOCITY;
+   pAxis = (arcusAxis *)pC->getAxis(0);
+
+   memset(st, 0, sizeof(st));
+   st[0].name = "poll cycle";
+   st[1].name = "move start";
+   st[2].name = "done-predict";
+   st[3].name = "stop";
+   st[4].name = "stop to done";
+   for(k = 0; k < 5; k++)
+      st[k].t = (double *)calloc(iterations, sizeof(double));
+   if(!st[0].t || !st[1].t || !st[2].t || !st[3].t || !st[4].t)
+   {
+      printf("arcusBenchmark: out of memory\n");
+      for(k = 0; k < 5; k++)
+         free(st[k].t);
+      return(asynError);
+   }
+
+   printf("arcusBenchmark: %s (%s), %d axes, %d iterations, %d steps at "
+      "%d steps/s\n", controllerPortName,
+      arcusController::ControllerTypeStrings[pC->ArcusModel], nAxes,
+      iterations, distance, velocity);
+
+   for(i = 0; i < iterations; i++)
+   {
+      pC->lock();
+      arcusBenchStart(pC, &m);
+      status = arcusBenchPoll(pC, nAxes, &moving);
+      arcusBenchEnd(pC, &m, &st[0], status);
+      pC->unlock();
+   }
+
+   /* Relative moves back and forth. Done latency is measured against the    */
+   /* end of the move predicted from its profile.                            */
+   predicted = arcusMoveTime(distance, velocity / 10.0, velocity, BENCH_ACCEL);
+   for(i = 0; i < iterations; i++, dir = -dir)
+   {
+      pC->lock();
+      arcusBenchStart(pC, &m);
+      status = pAxis->move(dir * distance, 1, velocity / 10.0, velocity,
+                           BENCH_ACCEL);
+      arcusBenchEnd(pC, &m, &st[1], status);
+      pC->unlock();
+      start = m.wall;
+      if(status != asynSuccess)
+         continue;
+      t = arcusBenchWaitDone(pC, nAxes, &start);
+      if(t < 0.0)
+         st[2].errors++;
+      else
+         st[2].t[st[2].n++] = fabs(t - predicted);
+   }
+
+   /* Jog, then stop; time the STOP and how long until done is seen.         */
+   for(i = 0; i < iterations; i++, dir = -dir)
+   {
+      pC->lock();
+      status = pAxis->moveVelocity(velocity / 10.0, dir * velocity,
+                                   BENCH_ACCEL);
+      pC->unlock();
+      if(status != asynSuccess)
+      {
+         st[3].errors++;
+         continue;
+      }
+      epicsThreadSleep(BENCH_JOG_TIME);
+      pC->lock();
+      arcusBenchStart(pC, &m);
+      status = pAxis->stop(BENCH_ACCEL);
+      arcusBenchEnd(pC, &m, &st[3], status);
+      pC->unlock();
+      start = m.wall;
+      if(status != asynSuccess)
+         continue;
+      t = arcusBenchWaitDone(pC, nAxes, &start);
+      if(t < 0.0)
+         st[4].errors++;
+      else
+         st[4].t[st[4].n++] = t;
+   }
+
+   printf("  %-13s %6s %7s %7s %9s %9s %9s %6s\n", "operation", "n",
+      "cmds", "trips", "p50 ms", "p99 ms", "cpu us", "errors");
+   for(k = 0; k < 5; k++)
+   {
+      arcusBenchReport(&st[k]);
+      free(st[k].t);
+   }
+   printf("  (done-predict: |time done was seen - predicted end of move|;\n"
+          "   cmds, trips and cpu are per operation, cpu is %s time)\n",
+          BENCH_CPU_LABEL);
+
+   return(asynSuccess);
+}
+
+static const iocshArg bm_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg bm_a1 = {"Number of axes to poll [int]",     iocshArgInt};
+static const iocshArg bm_a2 = {"Iterations [int]",                 iocshArgInt};
+static const iocshArg bm_a3 = {"Move distance (steps) [int]",      iocshArgInt};
+static const iocshArg bm_a4 = {"Velocity (steps/s) [int]",         iocshArgInt};
+
+static const iocshArg * const bm_as[] = {&bm_a0, &bm_a1, &bm_a2, &bm_a3,
+                                         &bm_a4};
+
+static const iocshFuncDef bm_def = {"arcusBenchmark", 5, bm_as};
+
+static void bm_fn(const iocshArgBuf *args)
+{
+	arcusBenchmark(args[0].sval, args[1].ival, args[2].ival, args[3].ival,
+      args[4].ival);
+}
+
+static const iocshArg pb_a0 = {"Iterations [int]",                iocshArgInt};
+
+static const iocshArg * const pb_as[] = {&pb_a0};
+
+static const iocshFuncDef pb_def = {"arcusParserBench", 1, pb_as};
+
+static void pb_fn(const iocshArgBuf *args)
+{
+	arcusParserBench(args[0].ival);
+}
+
+static void arcusBenchmarkRegister(void)
+{
+  iocshRegister(&pb_def, pb_fn);  // arcusParserBench
+  iocshRegister(&bm_def, bm_fn);  // arcusBenchmark
+}
+
+extern "C"
+{
+   epicsExportRegistrar(arcusBenchmarkRegister);
+}
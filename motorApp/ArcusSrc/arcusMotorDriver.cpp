@@ -19,6 +19,7 @@
 
 #include <asynCommonSyncIO.h>
 #include <asynOctetSyncIO.h>
+#include <asynOptionSyncIO.h>
 #include <asynMotorController.h>
 #include <asynMotorAxis.h>
 #include <arcusMotorDriver.h>
@@ -26,27 +27,86 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <exception>
 
 #include <math.h>
+#include <limits.h>
 
 #include <epicsString.h>
+#include <epicsAtomic.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <initHooks.h>
 #include <epicsExport.h>
 
-/* Static configuration parameters (compile-time constants) */
-//#undef  DEBUG
-//#define DEBUG 1
+const char *arcusController::ControllerTypeStrings[] = {"UNKNOWN",
+   "DMX-SERIES-ETH", "Performax-4ET-SA", "DriveMax-K-SA"};
+const char *arcusController::LinkStateStrings[] = {"UP", "SUSPECT", "DOWN"};
+const char *arcusController::ModelHintStrings[] = {"", "DMX-ETH", "PMX",
+   "DMX-K-SA"};
+const char *arcusCmdClassStrings[NUM_CMD_CLASSES] = {"STATUS", "ENCODER",
+   "POSITION", "SPEED", "MOTION", "STOP", "OTHER"};
+
+/* Upper edges (ms) of the latency histogram buckets; the last one is open.   */
+static const double arcusLatencyEdges[NUM_LATENCY_BUCKETS - 1] = {0.5, 1, 2,
+   5, 10, 20, 50, 100, 200, 500, 1000};
 
+const char *arcusParseStatusStrings[] = {"OK", "empty reply", "rejected",
+   "not a number", "out of range", "too few fields", "bad separator",
+   "trailing characters"};
+
+/* Static configuration parameters (compile-time constants) */
 #define CMD_LEN 50
+#define MAX_REPLY_FIELDS 4
 #define REP_LEN 50
 #define DEFLT_TIMEOUT 1.00
 
+/* Default command retry policy, see arcusSetRetryPolicy().                   */
+#define DEFLT_RETRIES     2
+#define DEFLT_BACKOFF_MIN 0.05
+#define DEFLT_BACKOFF_MAX 30.0
+#define RECONNECT_HOLDOFF 1.00
+
+/* A reply from a controller that sends no terminator is complete once the    */
+/* line has been quiet this long (s) after its first byte.                    */
+#define FRAME_GAP 0.005
+
+/* Start-up input flush: done once the line has been quiet FLUSH_QUIET (s),   */
+/* or after FLUSH_MAX (s) of continuous input.                                */
+#define FLUSH_QUIET 0.05
+#define FLUSH_MAX   1.00
+
+/* Idle DMX-K-SA axes polled per cycle while others move, see scheduleBus(). */
+#define DEFLT_IDLE_AXES 1
+
+/* Dense polling starts this long (s), plus PREDICT_SLACK of the move's      */
+/* predicted duration, before a move is predicted to end.                    */
+#define DEFLT_POLL_GUARD 0.20
+
+/* Statistics parameters are refreshed at most this often (s).                */
+#define STATS_PERIOD 1.0
+#define PREDICT_SLACK    0.05
+
 #define HOLD_FOREVER 60000
 #define HOLD_NEVER       0
 #define FAR_AWAY     1000000000 /*nm*/
 
-int DEBUG=1;
+/* Trace sites cost one compare when the controller's trace level is below   */
+/* theirs; build with -DARCUS_NO_TRACE to compile them out altogether. What   */
+/* passes the level still goes through asynPrint(), so ASYN_TRACEIO_DRIVER    */
+/* must be on in the port's trace mask too.                                   */
+#ifdef ARCUS_NO_TRACE
+#define ARCUS_TRACE(ctl, level, ...) do {} while(0)
+#else
+#define ARCUS_TRACE(ctl, level, ...)                                          \
+   do                                                                         \
+   {                                                                          \
+      if((ctl)->traceLevel_ >= (level))                                       \
+         asynPrint((ctl)->asynUserMot_p_, ASYN_TRACEIO_DRIVER, __VA_ARGS__);  \
+   } while(0)
+#endif
 
 // Windows does not have rint()
 #ifdef _WIN32
@@ -105,6 +165,69 @@ enum arcusDMXStatus {
    DMX_TOC_TO_Stat  = 1024
 };
 
+/* What the motor status (MST) bits mean to the motor record. Any number of   */
+/* bits can be set at once, so MST is decoded bit by bit through the tables   */
+/* below rather than compared against single values.                          */
+enum arcusStatusFlag {
+   ST_MOVING     = 1,
+   ST_HIGH_LIMIT = 2,
+   ST_LOW_LIMIT  = 4,
+   ST_HOME       = 8,
+   ST_PROBLEM    = 16
+};
+
+typedef struct arcusStatusBit {
+   int bit;
+   int flags;
+} arcusStatusBit;
+
+static const arcusStatusBit arcusPMXStatusBits[] = {
+   {PMX_Accelerating,  ST_MOVING},
+   {PMX_Decelerating,  ST_MOVING},
+   {PMX_Constant_Spd,  ST_MOVING},
+   {PMX_Alarm_Status,  ST_PROBLEM},
+   {PMX_Plus_Limit,    ST_HIGH_LIMIT},
+   {PMX_Minus_Limit,   ST_LOW_LIMIT},
+   {PMX_Home_Switch,   ST_HOME},
+   {PMX_Plus_Lim_Err,  ST_HIGH_LIMIT},
+   {PMX_Minus_Lim_Err, ST_LOW_LIMIT},
+   {PMX_Alarm_Err,     ST_PROBLEM},
+   {0, 0}
+};
+
+/* The latch input and Z index bits carry no motor record status. The latch  */
+/* bit is the level of the input, not a capture; see arcusAxis::pollLatch().  */
+static const arcusStatusBit arcusDMXStatusBits[] = {
+   {DMX_Constant_Spd,  ST_MOVING},
+   {DMX_Accelerating,  ST_MOVING},
+   {DMX_Decelerating,  ST_MOVING},
+   {DMX_Home_Switch,   ST_HOME},
+   {DMX_Minus_Limit,   ST_LOW_LIMIT},
+   {DMX_Plus_Limit,    ST_HIGH_LIMIT},
+   {DMX_Minus_Lim_Err, ST_LOW_LIMIT},
+   {DMX_Plus_Lim_Err,  ST_HIGH_LIMIT},
+   {DMX_TOC_TO_Stat,   ST_PROBLEM},
+   {0, 0}
+};
+
+/* Decode an MST value into arcusStatusFlag bits.                             */
+static int arcusDecodeStatus(arcusController::ControllerType_t model, int mst)
+{
+   const arcusStatusBit *p;
+   int                  flags = 0;
+
+   if(model == arcusController::PMX_4ET_SA)
+      p = arcusPMXStatusBits;
+   else if(model != arcusController::UNKNOWN)
+      p = arcusDMXStatusBits;
+   else
+      return(0);
+   for(; p->bit; p++)
+      if(mst & p->bit)
+         flags |= p->flags;
+   return(flags);
+}
+
 arcusException::arcusException(arcusExceptionType t, const char *fmt, ...)
 	: t_(t)
 {
@@ -124,27 +247,151 @@ arcusException::arcusException(arcusExceptionType t, const char *fmt, va_list ap
 	epicsVsnprintf(str_, sizeof(str_), fmt, ap);
 }
 
+/* Completion event of each thread that submits I/O, see submit().           */
+static epicsThreadPrivateId arcusIoDoneId = 0;
+
+/* Deferred initialisation, see arcusSetDeferredInit.                        */
+static bool            arcusDeferInit = false;
+static arcusController *arcusDeferredList = 0;
+
+static void arcusInitThreadC(void *pPvt)
+{
+   ((arcusController *)pPvt)->initThread();
+}
+
+/* iocInit must not get to the device support before every controller and   */
+/* axis has been probed: let the axis probes go, then wait for them all.     */
+static void arcusDeferInitHook(initHookState state)
+{
+   if(state == initHookAtBeginning)
+      arcusController::finishDeferredInit();
+}
+
+static void arcusHookDeferredInit(void)
+{
+   static bool hooked = false;
+
+   if(!hooked)
+   {
+      initHookRegister(arcusDeferInitHook);
+      hooked = true;
+   }
+}
+
+void arcusController::finishDeferredInit()
+{
+   arcusController *pC;
+   epicsTimeStamp  start, now;
+
+   if(!arcusDeferredList)
+      return;
+   epicsTimeGetCurrent(&start);
+   for(pC = arcusDeferredList; pC; pC = pC->nextDeferred_)
+      epicsEventSignal(pC->axesReady_);
+   for(pC = arcusDeferredList; pC; pC = pC->nextDeferred_)
+      epicsEventMustWait(pC->initDone_);
+   arcusDeferredList = 0;
+   epicsTimeGetCurrent(&now);
+   epicsPrintf("arcus: controllers initialised, waited %.3f s\n",
+      epicsTimeDiffInSeconds(&now, &start));
+}
+
 arcusController::arcusController(const char *portName, const char *IOPortName,
    int numAxes, double movingPollPeriod, double idlePollPeriod,
-   int ArcusControllerFlag /* 0=Normal?, 1=RS-485 style */)
+   int ArcusControllerFlag /* 0=Normal?, 1=RS-485 style */,
+   int maxBaud /* 0=leave the serial line alone */, int storeBaud,
+   const char *modelHint /* 0 or "" to ask the controller */)
 	: asynMotorController(portName, numAxes,
-   0, // parameters
-	0, // interface mask
-	0, // interrupt mask
+   NUM_ARCUS_PARAMS, // parameters
+	asynInt32ArrayMask | asynFloat64ArrayMask, // interface mask
+	asynInt32ArrayMask | asynFloat64ArrayMask, // interrupt mask
 	ASYN_CANBLOCK | ASYN_MULTIDEVICE,
 	1, // autoconnect
 	0,0) // default priority
 	, asynUserMot_p_(0)
+   , asynUserOption_p_(0)
+   , linkState_(LINK_UP)
+   , retries_(DEFLT_RETRIES)
+   , backoffMin_(DEFLT_BACKOFF_MIN)
+   , backoffMax_(DEFLT_BACKOFF_MAX)
+   , holdOff_(RECONNECT_HOLDOFF)
+   , rxLen_(0)
+   , linkGeneration_(0)
+   , pipeline_(true)
+   , eosSeen_(false)
+   , idleAxesPerCycle_(DEFLT_IDLE_AXES)
+   , nextIdleAxis_(0)
+   , densePollPeriod_(0.0)
+   , pollGuard_(DEFLT_POLL_GUARD)
+   , txCmds_(0)
+   , txRoundTrips_(0)
+   , retryCount_(0)
+   , reconnectCount_(0)
+   , timeoutCount_(0)
+   , traceLevel_(ARCUS_TRACE_NONE)
+   , positionDeadband_(0)
+   , deferMoves_(false)
+   , rs485First_(ArcusControllerFlag == 1)
+   , initPending_(false)
+   , nextDeferred_(0)
+   , urgentQueued_(0)
+   , ioThreadId_(0)
+   , pollerId_(0)
+   , cache_(0)
+   , cacheAge_(0.0)
+   , profileEvent_(0)
+   , profileAborted_(false)
+   , profileNumRead_(0)
 {
-   asynStatus status;
-   char       junk[100];
-   size_t     got_junk;
-   int        eomReason;
+   char       name[40];
+   int        i;
    pAxes_ = (arcusAxis **)(asynMotorController::pAxes_);
-   /* Additional var needed to determine the Arus Controller type.            */
-   char rbuf[80];
-   char wbuf[80];
-   size_t outCount, inCount, bufLen;
+
+   if(!arcusIoDoneId)
+      arcusIoDoneId = epicsThreadPrivateCreate();
+   ioLock_     = epicsMutexMustCreate();
+   ioWake_     = epicsEventMustCreate(epicsEventEmpty);
+   urgentWake_ = epicsEventMustCreate(epicsEventEmpty);
+   cacheLock_  = epicsMutexMustCreate();
+   memset(ioHead_, 0, sizeof(ioHead_));
+   memset(ioTail_, 0, sizeof(ioTail_));
+
+   memset(cmdStats_, 0, sizeof(cmdStats_));
+   memset(latencySnap_, 0, sizeof(latencySnap_));
+   epicsTimeGetCurrent(&statsPublished_);
+   for(i = 0; i < NUM_CMD_CLASSES; i++)
+   {
+      sprintf(name, "ARCUS_%s_COUNT", arcusCmdClassStrings[i]);
+      createParam(name, asynParamInt32, &arcusCmdCount_[i]);
+   }
+   for(i = 0; i < NUM_CMD_CLASSES; i++)
+   {
+      sprintf(name, "ARCUS_%s_ERRORS", arcusCmdClassStrings[i]);
+      createParam(name, asynParamInt32, &arcusCmdErrors_[i]);
+   }
+   for(i = 0; i < NUM_CMD_CLASSES; i++)
+   {
+      sprintf(name, "ARCUS_%s_LATENCY", arcusCmdClassStrings[i]);
+      createParam(name, asynParamInt32Array, &arcusCmdLatency_[i]);
+   }
+   createParam("ARCUS_RETRIES",    asynParamInt32, &arcusRetries_);
+   createParam("ARCUS_RECONNECTS", asynParamInt32, &arcusReconnects_);
+   createParam("ARCUS_TIMEOUTS",   asynParamInt32, &arcusTimeouts_);
+   createParam("ARCUS_LATCH_ARM",  asynParamInt32, &arcusLatchArm_);
+   createParam("ARCUS_LATCH_COUNT", asynParamInt32, &arcusLatchCount_);
+   createParam("ARCUS_LATCH_ENCODER", asynParamInt32Array,
+               &arcusLatchEncoder_);
+   createParam("ARCUS_LATCH_POSITION", asynParamInt32Array,
+               &arcusLatchPosition_);
+   createParam("ARCUS_LATCH_TIME", asynParamFloat64Array, &arcusLatchTime_);
+   createParam("ARCUS_SAMPLE_ENCODER", asynParamInt32Array,
+               &arcusSampleEncoder_);
+   createParam("ARCUS_SAMPLE_POSITION", asynParamInt32Array,
+               &arcusSamplePosition_);
+   createParam("ARCUS_SAMPLE_STATUS", asynParamInt32Array,
+               &arcusSampleStatus_);
+   createParam("ARCUS_SAMPLE_TIME", asynParamFloat64Array, &arcusSampleTime_);
+   ArcusModel = UNKNOWN;  /* Until the ID reply tells us otherwise.          */
    
 	if (pasynCommonSyncIO->connect(IOPortName, 0, &asynUserCommonMot_p_, NULL)
     || pasynOctetSyncIO->connect(IOPortName, 0, &asynUserMot_p_, NULL)) {
@@ -153,17 +400,59 @@ arcusController::arcusController(const char *portName, const char *IOPortName,
 		THROW_(arcusException(MCSConnectionError,
          "arcusController: unable to connect I/O channel."));
 	}
+   /* Only needed to change the baud rate of a serial port.                   */
+   if((maxBaud > 0) &&
+      pasynOptionSyncIO->connect(IOPortName, 0, &asynUserOption_p_, NULL))
+      asynUserOption_p_ = 0;
 
    asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
          "\narcusController: ArcusControllerFlag = %d.\n", ArcusControllerFlag);
 
+   /* Save the following config commands for the startup file, st.cmd.        */
+	//pasynOctetSyncIO->setInputEos ( asynUserMot_p_, "\r", 1 );
+	//pasynOctetSyncIO->setOutputEos( asynUserMot_p_, "\r", 1 );
+
+   densePollPeriod_ = movingPollPeriod;
+   idlePeriod_      = idlePollPeriod;
+   maxBaud_         = maxBaud;
+   storeBaud_       = storeBaud;
+   modelHint_[0]    = 0;
+   if(modelHint)
+      strncat(modelHint_, modelHint, sizeof(modelHint_) - 1);
+   if(arcusDeferInit || (maxBaud_ > 0))
+   {
+      /* Probe on a thread of our own, see arcusDeferInitHook(). The baud     */
+      /* rate is negotiated with the drives of our axes, so it has to wait    */
+      /* for them to exist as well.                                           */
+      arcusHookDeferredInit();
+      initPending_ = true;
+      axesReady_ = epicsEventMustCreate(epicsEventEmpty);
+      initDone_  = epicsEventMustCreate(epicsEventEmpty);
+      nextDeferred_ = arcusDeferredList;
+      arcusDeferredList = this;
+      epicsThreadCreate("arcusInit", epicsThreadPriorityMedium,
+         epicsThreadGetStackSize(epicsThreadStackMedium),
+         arcusInitThreadC, this);
+      return;
+   }
+   probe();
+   startIoThread();
+	startPoller(movingPollPeriod, idlePollPeriod, 0);
+}
+
+/* Find out which controller is on the line and set the line up for it.       */
+void arcusController::probe()
+{
+   /* Additional var needed to determine the Arus Controller type.            */
+   char   rbuf[80];
+   size_t inCount;
+   int    i;
+
 	/* Clear the read buffer, just in case.  */                                  
-	pasynOctetSyncIO->read(asynUserMot_p_, junk, sizeof(junk), 2.0, &got_junk,
-      &eomReason);
-	if(got_junk)
+	if(flushInput())
    {
-		epicsPrintf("arcusController(%s): WARNING: unexpected characters, (%s).\n",
-         portName, IOPortName);
+		epicsPrintf("arcusController(%s): WARNING: unexpected characters.\n",
+         portName);
 	}
    
    /* Determine which flavor Arcus controller we're talking to.               */
@@ -178,522 +467,2090 @@ arcusController::arcusController(const char *portName, const char *IOPortName,
    //   outCount = 5;
    //}
 
-   sprintf(wbuf, "ID\n");
-   outCount = 2;
-   bufLen = 80;
-   status = pasynOctetSyncIO->writeRead(asynUserMot_p_, wbuf, outCount,
-            rbuf, bufLen, DEFLT_TIMEOUT, &outCount, &inCount, &eomReason);
-
-   if(inCount == 0)
+   /* A model hint from st.cmd saves asking; the reply is matched below.      */
+   rbuf[0] = 0;
+   if(modelHint_[0])
    {
-      sprintf(wbuf, "@01ID\n");
-      outCount = 5;
-      bufLen = 80;
-      status = pasynOctetSyncIO->writeRead(asynUserMot_p_, wbuf, outCount,
-            rbuf, bufLen, DEFLT_TIMEOUT, &outCount, &inCount, &eomReason);
+      for(i = 1; i <= DMX_K_SA; i++)
+         if(!epicsStrCaseCmp(modelHint_, ModelHintStrings[i]) ||
+            !epicsStrCaseCmp(modelHint_, ControllerTypeStrings[i]))
+            strcpy(rbuf, ControllerTypeStrings[i]);
+      if(!rbuf[0])
+         epicsPrintf("arcusController(%s): WARNING: unknown model %s, asking "
+            "the controller.\n", portName, modelHint_);
    }
+   inCount = rbuf[0] ? strlen(rbuf) : identify(rbuf, sizeof(rbuf));
+
+   /* A drive that was left at another baud rate won't answer; go find it.    */
+   if((inCount == 0) && (maxBaud_ > 0))
+      inCount = probeBaud(rbuf, sizeof(rbuf));
 
    if(strstr(rbuf, ControllerTypeStrings[1]) != NULL)
    {
       ArcusModel = DMX_ETH;
-      //if(DEBUG)
          asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
             "\nController Type is %s.\n", ControllerTypeStrings[ArcusModel]);
    }
    else if(strstr(rbuf, ControllerTypeStrings[2]) != NULL)
    {
       ArcusModel = PMX_4ET_SA;
-      //if(DEBUG)
          asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
             "\nController Type is %s.\n", ControllerTypeStrings[ArcusModel]);
    }
    else if(strstr(rbuf, ControllerTypeStrings[3]) != NULL)
    {
       ArcusModel = DMX_K_SA;
-      //if(DEBUG)
          asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
             "\nController Type is %s.\n", ControllerTypeStrings[ArcusModel]);
    }
    else
    {
       ArcusModel = UNKNOWN;
-      //if(DEBUG)
          asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
             "\nController Type is %s.\n", ControllerTypeStrings[ArcusModel]);
    }
    
-   /* Save the following config commands for the startup file, st.cmd.        */
-	//pasynOctetSyncIO->setInputEos ( asynUserMot_p_, "\r", 1 );
-	//pasynOctetSyncIO->setOutputEos( asynUserMot_p_, "\r", 1 );
-
-	startPoller(movingPollPeriod, idlePollPeriod, 0);
 }
 
-/* got_p   - Number of bytes read.                                            */
-/* rep     - The buffer holding the response.                                 */
-/* len     - The length of the response buffer.                               */
-/* timeout - Obvious                                                          */
-/* cmd     - The command to send, already formatted.                          */
-/* cmsLen  - The llength of the command being sent.                           */
-asynStatus arcusController::sendCmd(size_t *got_p, char *rep, int len,
-    double timeout, const char *cmd, int cmdLen)
+/* Deferred initialisation: the controller is probed at once, on this thread, */
+/* while st.cmd goes on; its axes once iocInit begins, when they all exist.   */
+void arcusController::initThread()
 {
-   //char       buf[CMD_LEN];
-   size_t     nwrite;
-   int        eomReason;
-   asynStatus status;
-   int pass = 0;
+   int i;
+
+   probe();
+   epicsEventMustWait(axesReady_);
+   lock();
+   for(i = 0; i < numAxes_; i++)
+      if(pAxes_[i])
+         pAxes_[i]->probe();
+   if((maxBaud_ > 0) && (ArcusModel == DMX_K_SA))
+      negotiateBaud(maxBaud_, storeBaud_ != 0);
+   initPending_ = false;
+   unlock();
+   startIoThread();
+	startPoller(densePollPeriod_, idlePeriod_, 0);
+   epicsEventSignal(initDone_);
+}
 
-	//epicsVsnprintf(buf, sizeof(buf), fmt, ap);
+/* Ask the controller who it is, as a plain controller and as drive 01 of an */
+/* RS-485 style bus, the one the ArcusControllerFlag names first. The other   */
+/* is only tried if nobody answers. Returns the length of the reply in rbuf,  */
+/* zero if nobody answered.                                                   */
+size_t arcusController::identify(char *rbuf, int len)
+{
+   static const char * const ids[2] = {"ID", "@01ID"};
+   size_t inCount;
+   int    i = rs485First_ ? 1 : 0;
 
-   for (;;) {
-      status = pasynOctetSyncIO->writeRead(asynUserMot_p_, cmd, cmdLen, rep,
-                                    len, timeout, &nwrite, got_p, &eomReason);
-      if (status == asynSuccess) break;
-      asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-               "sendCmd(\"%s\"), status:%d, inCount:%d, pass:%d\n",
-                                               cmd, status, (int)*got_p, pass);
-      if (++pass == 5) break;
-      if (pass > 1) {
-         status = pasynCommonSyncIO->disconnectDevice(asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
-                              "Warning -- unable to disconnect from device\n");
-         }
-         status = pasynCommonSyncIO->connectDevice(asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
-                                 "Warning -- unable to reconnect to device\n");
-         }
-      }
-   }
+   rbuf[0] = 0;
+   writeReadOnce(&inCount, rbuf, len, DEFLT_TIMEOUT, ids[i], strlen(ids[i]));
+   if(inCount == 0)
+      writeReadOnce(&inCount, rbuf, len, DEFLT_TIMEOUT, ids[!i],
+                    strlen(ids[!i]));
+   return(inCount);
+}
 
-	//asynPrint(c_p_->pasynUserSelf, ASYN_TRACEIO_DRIVER, "sendCmd()=%s", buf);
+/* Read and drop whatever is waiting on the line (the tail of a reply to a    */
+/* previous IOC, say) until it has been quiet for FLUSH_QUIET, but for no     */
+/* longer than FLUSH_MAX in all. Returns the number of bytes dropped.         */
+size_t arcusController::flushInput()
+{
+   char           junk[100];
+   size_t         got, total = 0;
+   int            eomReason;
+   epicsTimeStamp start, now;
 
-	return status;
+   epicsTimeGetCurrent(&start);
+   do
+   {
+      got = 0;
+      pasynOctetSyncIO->read(asynUserMot_p_, junk, sizeof(junk), FLUSH_QUIET,
+                             &got, &eomReason);
+      total += got;
+      epicsTimeGetCurrent(&now);
+   } while(got && (epicsTimeDiffInSeconds(&now, &start) < FLUSH_MAX));
+   rxLen_ = 0;
+   return(total);
 }
 
-/* Parse reply from ARCUS and return the value converted to a number.
- * So far, I don't think this function is used for the ARCUS.
- *
- * If the string cannot be parsed, i.e., is not in the format
- *  ':' , <string_of_upper_case_letters> , <number1> , ',' , <number2>
- * 
- * then the routine returns '-1'.
- *
- * Otherwise, if <string_of_upper_case_letters> starts with 'E'
- * (which means an 'Error' code) then the (always non-negative)
- * error code is returned (may be zero in case of an 'acknowledgement'
- * message in synchronous mode).
- *
- * If the string is parsed successfully then <number2> is passed up
- * in *val_p.
- *
- * Hence - return code nonzero -> error (error code if > 0, parse error
- *                                otherwise)
- *       - return code zero    -> successful ACK or command reply; value
- *                                in *val_p.
- */ 
-int arcusController::parseReply(const char *reply, int *ax_p, int *val_p)
+/* Serial line rates the DMX-K-SA supports and the matching DB= setting.      */
+static const struct {
+   int baud;
+   int db;
+} arcusBaudRates[] = {
+   {  9600, 1},
+   { 19200, 2},
+   { 38400, 3},
+   { 57600, 4},
+   {115200, 5}
+};
+#define NUM_BAUD_RATES (int)(sizeof(arcusBaudRates)/sizeof(arcusBaudRates[0]))
+
+/* Set the baud rate of the asyn serial port, returns asynError for ports     */
+/* that have no baud rate (i.e. IP ports).                                    */
+asynStatus arcusController::setPortBaud(int baud)
 {
-   char cmd[10];
-   
-	if ( 3 != sscanf(reply, ":%10[A-Z]%i,%i", cmd, ax_p, val_p) )
-		return -1;
-	return 'E' == cmd[0] ? *val_p : 0;
+   char val[20];
+
+   if(!asynUserOption_p_)
+      return(asynError);
+   sprintf(val, "%d", baud);
+   return(pasynOptionSyncIO->setOption(asynUserOption_p_, "baud", val,
+                                       DEFLT_TIMEOUT));
 }
 
-/* For the Arcus motor controllers, axis 0 corresponds to X, 1-Y, 2-Z, 3-U    */
-/* For now, channel means the same thing.                                     */
-arcusAxis::arcusAxis(class arcusController *cnt_p, int axis, int channel)
-	: asynMotorAxis(cnt_p, axis), c_p_(cnt_p)
+asynStatus arcusController::getPortBaud(int *baud)
 {
-	int val;
-   if(channel == 0)
-   	channel_ = 'X';
-   else if(channel == 1)
-      channel_ = 'Y';
-   else if(channel == 2)
-      channel_ = 'Z';
-   else if(channel == 3)
-      channel_ = 'U';
-   else
-      channel_ = '?';
+   char       val[20];
+   asynStatus status;
 
-   if(c_p_->ArcusModel == arcusController::DMX_K_SA)
-      sprintf(Arcus_Com_Prefix, "@%02d", channel + 1);
-   else
-      Arcus_Com_Prefix[0] = 0;
-   
-   axis_ = axis; /* Need to remember our axis number.                         */
-   
-	asynPrint(/*c_p_->pasynUserSelf*/c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-             "\narcusAxis::arcusAxis -- creating axis %u\n", axis);
+   if(!asynUserOption_p_)
+      return(asynError);
+   status = pasynOptionSyncIO->getOption(asynUserOption_p_, "baud", val,
+                                         sizeof(val), DEFLT_TIMEOUT);
+   if(status == asynSuccess)
+      *baud = atoi(val);
+   return(status);
+}
 
-	comStatus_ = getAxisStatus(axis, &val);
-   
-   asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\narcusAxis: Status of %u returned %i(%d)\n", axis, comStatus_, val);
+/* Nobody answered at the port's baud rate; try the others in turn. If the    */
+/* drive answers nowhere, the port is put back the way it was.                */
+size_t arcusController::probeBaud(char *rbuf, int len)
+{
+   int    baud, i;
+   size_t inCount = 0;
 
-	if(comStatus_ == 0)
+   if(getPortBaud(&baud) != asynSuccess)
+      return(0);
+   for(i = 0; i < NUM_BAUD_RATES; i++)
    {
-		setIntegerParam(c_p_->motorStatusHasEncoder_, 1);
-		setIntegerParam(c_p_->motorStatusGainSupport_, 1);
-	}
-
-	callParamCallbacks();
+      if(arcusBaudRates[i].baud == baud)
+         continue;
+      if(setPortBaud(arcusBaudRates[i].baud) != asynSuccess)
+         continue;
+      inCount = identify(rbuf, len);
+      if(inCount > 0)
+      {
+         epicsPrintf("arcusController(%s): found controller at %d baud\n",
+            portName, arcusBaudRates[i].baud);
+         return(inCount);
+      }
+   }
+   setPortBaud(baud);
+   return(0);
+}
 
-	if(comStatus_)
-   {
-		THROW_(arcusException(MCSCommunicationError,
-         "arcusAxis::arcusAxis -- channel %u ASYN error %i", axis, comStatus_));
-	}
+/* True for the first axis on each RS-485 drive address, so that every drive  */
+/* of our axes is told about a new baud rate exactly once.                    */
+bool arcusController::firstOnDrive(int axis) const
+{
+   int i;
+
+   if(!pAxes_[axis] || !pAxes_[axis]->Arcus_Com_Prefix[0])
+      return(false);
+   for(i = 0; i < axis; i++)
+      if(pAxes_[i] && !strcmp(pAxes_[i]->Arcus_Com_Prefix,
+                              pAxes_[axis]->Arcus_Com_Prefix))
+         return(false);
+   return(true);
 }
 
-/* Request the Motor Status from the ARCUS controller. This is really a       */
-/* controller function, but each axis should be able to get its own value as  */
-/* well. The status values are different between the PMX and DMX controllers  */
-/* according to the manuals, but that's not what I see in the lab. More later */
-asynStatus arcusAxis::getAxisStatus(int axis, int *val)
+/* Move the DMX-K-SA drives of our axes and the serial port to the fastest    */
+/* rate both support, up to maxBaud. The port is first switched to the new   */
+/* rate and back, so that no drive is told of a rate the port can't follow.  */
+/* Then the drives are told (they answer at the old rate), the port follows  */
+/* and every drive must answer ID at the new rate. Otherwise the drives told */
+/* are sent back, at the new rate they now listen at, and the port returns   */
+/* to the old rate. With store set, the new rate is saved in the drives so   */
+/* they come up at it after a power cycle; without it the drives return to   */
+/* their stored rate, which probeBaud() finds on the next boot.              */
+asynStatus arcusController::negotiateBaud(int maxBaud, bool store)
 {
-   asynStatus status;
-   char rbuf[80];
-   char wbuf[80];
-   size_t outCount, inCount, bufLen;
-   int eomReason;
-   int one, two, three, four;
-   int pass = 0;
+   char       rep[REP_LEN];
+   char       cmd[CMD_LEN];
+   size_t     got;
+   int        oldBaud, oldIdx = -1, newIdx = -1;
+   int        i, d, told;
+   bool       ok = true;
+
+   if(getPortBaud(&oldBaud) != asynSuccess)
+      return(asynError);
+   for(i = 0; i < NUM_BAUD_RATES; i++)
+   {
+      if(arcusBaudRates[i].baud == oldBaud)
+         oldIdx = i;
+      if(arcusBaudRates[i].baud <= maxBaud)
+         newIdx = i;
+   }
+   if((oldIdx < 0) || (newIdx < 0) || (newIdx == oldIdx))
+      return(asynSuccess);
 
-   /* This command is common to all (so far) Arcus controllers??              */
-   sprintf(wbuf, "%sMST", Arcus_Com_Prefix);
-   outCount = strlen(wbuf);
-   bufLen = 80;
-   for (;;) {
-      status = pasynOctetSyncIO->writeRead(c_p_->asynUserMot_p_, wbuf, outCount,
-                  rbuf, bufLen, DEFLT_TIMEOUT, &outCount, &inCount, &eomReason);
-      if (status == asynSuccess) break;
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-               "getAxisStatus: status:%d inCount:%d eomReason:%d\n",
-                                             status, (int)inCount, eomReason);
-      if (++pass == 5) break;
-      if (pass > 1) {
-         status = pasynCommonSyncIO->disconnectDevice(c_p_->asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                              "Warning -- unable to disconnect from device\n");
-         }
-         status = pasynCommonSyncIO->connectDevice(c_p_->asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                                 "Warning -- unable to reconnect to device\n");
-         }
-      }
+   ok = (setPortBaud(arcusBaudRates[newIdx].baud) == asynSuccess);
+   if((setPortBaud(oldBaud) != asynSuccess) || !ok)
+   {
+      epicsPrintf("arcusController(%s): WARNING: serial port can't switch to "
+         "%d baud, staying at %d.\n", portName, arcusBaudRates[newIdx].baud,
+         oldBaud);
+      return(asynError);
    }
-   
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\ngetAxisStatus: Status = %d, eomReason = %d.\n", status, eomReason);
-   /* For some reason, when the DMX type controllers return a single 0, the   */
-   /* writeRead function returns a timeout.?. For now, we'll check for that   */
-   /* and just continue as if nothing happened.                               */
-   //if((status == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-   //   status = (asynStatus)0;
-   
-   if(status == 0)
+
+   for(told = 0; ok && (told < numAxes_); told++)
+   {
+      /* A drive that didn't answer may still have switched: count it told. */
+      if(!firstOnDrive(told))
+         continue;
+      sprintf(cmd, "%sDB=%d", pAxes_[told]->Arcus_Com_Prefix,
+              arcusBaudRates[newIdx].db);
+      ok = (writeReadOnce(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmd,
+                          strlen(cmd)) == asynSuccess);
+   }
+
+   if(ok)
+      ok = (setPortBaud(arcusBaudRates[newIdx].baud) == asynSuccess);
+   if(ok)
    {
-      /* The PMX-4ET-SA is the uniques controller. Deal with it.              */
-      if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
+      epicsThreadSleep(0.05);
+      for(d = 0; ok && (d < numAxes_); d++)
       {
-         sscanf(rbuf, "%d:%d:%d:%d", &one, &two, &three, &four);
-         //printf("arcusAxis: %s, %u.\n", rbuf, (unsigned int)inCount);
-         switch(axis)
-         {
-            case 0:
-               *val = one;
-               break;
-            case 1:
-               *val = two;
-               break;
-            case 2:
-               *val = three;
-               break;
-            case 3:
-               *val = four;
-               break;
-         }
+         if(!firstOnDrive(d))
+            continue;
+         sprintf(cmd, "%sID", pAxes_[d]->Arcus_Com_Prefix);
+         ok = (writeReadOnce(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmd,
+                             strlen(cmd)) == asynSuccess) && (got > 0);
       }
-      /* The rest of the supported models respond the same.                   */
-      else if(c_p_->ArcusModel != arcusController::UNKNOWN)
+      if(ok)
       {
-         sscanf(rbuf, "%d", &one);
-         *val = one;
+         for(d = 0; store && (d < numAxes_); d++)
+         {
+            if(!firstOnDrive(d))
+               continue;
+            sprintf(cmd, "%sSTORE", pAxes_[d]->Arcus_Com_Prefix);
+            writeReadOnce(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmd,
+                          strlen(cmd));
+         }
+         epicsPrintf("arcusController(%s): serial line now at %d baud%s\n",
+            portName, arcusBaudRates[newIdx].baud, store ? " (stored)" : "");
+         return(asynSuccess);
       }
    }
 
-   return(status);
+   /* Put back the drives told, at the new rate they switched to. One that   */
+   /* didn't switch can't hear this, but is at the old rate already.         */
+   setPortBaud(arcusBaudRates[newIdx].baud);
+   epicsThreadSleep(0.05);
+   for(d = 0; d < told; d++)
+   {
+      if(!firstOnDrive(d))
+         continue;
+      sprintf(cmd, "%sDB=%d", pAxes_[d]->Arcus_Com_Prefix,
+              arcusBaudRates[oldIdx].db);
+      writeReadOnce(&got, rep, sizeof(rep), 0.1, cmd, strlen(cmd));
+   }
+   setPortBaud(oldBaud);
+   epicsThreadSleep(0.05);
+   epicsPrintf("arcusController(%s): WARNING: could not switch to %d baud, "
+      "staying at %d.\n", portName, arcusBaudRates[newIdx].baud, oldBaud);
+   return(asynError);
 }
 
-/* Request the encoder value from the controller for given axis.              */
-asynStatus arcusAxis::getEncoderVal(int axis, int *val)
+/* Replies from the Ethernet controllers end in a NUL, replies from the       */
+/* serial DMX-K-SA in a CR. Until the model is known, accept any of them.     */
+bool arcusController::isReplyTerminator(char c) const
 {
-   asynStatus status;
-   char rbuf[80];
-   char wbuf[80];
-   size_t outCount, inCount, bufLen;
-   int eomReason;
-   int one, two, three, four;
-   int pass = 0;
-
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-      sprintf(wbuf, "PE"); /* EX for the DMX-ETH. */
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-      sprintf(wbuf, "%sEX", Arcus_Com_Prefix);
-   outCount = strlen(wbuf);
-   bufLen = 80;
-   for (;;) {
-      status = pasynOctetSyncIO->writeRead(c_p_->asynUserMot_p_, wbuf, outCount,
-               rbuf, bufLen, DEFLT_TIMEOUT, &outCount, &inCount, &eomReason);
-      if (status == asynSuccess) break;
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                "getEncoderVal: status:%d inCount:%d eomReason:%d pass:%d\n",
-                                         status, (int)inCount, eomReason, pass);
-      if (++pass == 5) break;
-      if (pass > 1) {
-         status = pasynCommonSyncIO->disconnectDevice(c_p_->asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                              "Warning -- unable to disconnect from device\n");
-         }
-         status = pasynCommonSyncIO->connectDevice(c_p_->asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                                 "Warning -- unable to reconnect to device\n");
-         }
-      }
-   }
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\ngetEncoderValue: Status = %d, inCount = %lu.\n", status, inCount);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   //if((status == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA) &&
-   //   (inCount > 0))
-   //   status = (asynStatus)0;
-   
-   if(status == 0)
+   switch(ArcusModel)
    {
-      /* The PMX-4ET-SA is the uniques controller. Deal with it.              */
-      if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-      {
-         sscanf(rbuf, "%d:%d:%d:%d", &one, &two, &three, &four);
-         //printf("arcusAxis: %s, %u.\n", rbuf, (unsigned int)inCount);
-         switch(axis)
-         {
-            case 0:
-               *val = one;
-               break;
-            case 1:
-               *val = two;
-               break;
-            case 2:
-               *val = three;
-               break;
-            case 3:
-               *val = four;
-               break;
-         }
-      }
-      /* The rest of the supported models respond the same.                   */
-      else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-      {
-         sscanf(rbuf, "%d", &one);
-         *val = one;
-      }
+      case DMX_ETH:
+      case PMX_4ET_SA:
+         return(c == '\0');
+      case DMX_K_SA:
+         return(c == '\r');
+      default:
+         return((c == '\0') || (c == '\r') || (c == '\n'));
    }
+}
 
-   return(status);
+/* The DMX-ETH may send its reply with no terminator at all (see st.cmd),     */
+/* so for it, and while the model is still unknown, a quiet line also ends a  */
+/* reply.                                                                     */
+bool arcusController::frameOnGap() const
+{
+   return((ArcusModel == DMX_ETH) || (ArcusModel == UNKNOWN));
 }
 
-asynStatus arcusAxis::getPositionVal(int axis, int *val)
+/* Read one reply. The reply is complete as soon as its terminator arrives    */
+/* (or an asynInterposeEos layer reports the EOS), rather than when the read  */
+/* times out. Bytes past the terminator stay in rxBuf_ for the next reply.    */
+asynStatus arcusController::readFrame(size_t *got_p, char *rep, int len,
+    double timeout)
 {
-   asynStatus status;
-   char rbuf[80];
-   char wbuf[80];
-   size_t outCount, inCount, bufLen;
-   int eomReason;
-   int one, two, three, four;
-   int pass = 0;
-
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-      sprintf(wbuf, "PP");
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-      sprintf(wbuf, "%sPX", Arcus_Com_Prefix);
-   outCount = strlen(wbuf);
-   bufLen = 80;
-   for (;;) {
-      status = pasynOctetSyncIO->writeRead(c_p_->asynUserMot_p_, wbuf, outCount,
-               rbuf, bufLen, DEFLT_TIMEOUT, &outCount, &inCount, &eomReason);
-      if (status == asynSuccess) break;
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-               "getPositionVal: status:%d inCount:%d eomReason:%d\n",
-                                            status, (int)inCount, eomReason);
-      if (++pass == 5) break;
-      if (pass > 1) {
-         status = pasynCommonSyncIO->disconnectDevice(c_p_->asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                              "Warning -- unable to disconnect from device\n");
-         }
-         status = pasynCommonSyncIO->connectDevice(c_p_->asynUserCommonMot_p_);
-         if (status != asynSuccess) {
-            asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
-                                 "Warning -- unable to reconnect to device\n");
-         }
-      }
-   }
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   //if((status == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA) &&
-   //   (inCount > 0))
-   //   status = (asynStatus)0;
-   
-   if(status == 0)
+   asynStatus     status = asynSuccess;
+   epicsTimeStamp start, now;
+   double         wait;
+   size_t         nread, i, n;
+   int            eomReason;
+   bool           complete = false;
+   bool           gapWait;
+
+   epicsTimeGetCurrent(&start);
+   for(;;)
    {
-      /* The PMX-4ET-SA is the uniques controller. Deal with it.              */
-      if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
+      for(i = 0; i < rxLen_; i++)
+         if(isReplyTerminator(rxBuf_[i]))
+            break;
+      if(i < rxLen_)
+         eosSeen_ = true;
+      if((i < rxLen_) || complete)
+         break;
+      if(rxLen_ == sizeof(rxBuf_))
       {
-         sscanf(rbuf, "%d:%d:%d:%d", &one, &two, &three, &four);
-         //printf("arcusAxis: %s, %u.\n", rbuf, (unsigned int)inCount);
-         switch(axis)
-         {
-            case 0:
-               *val = one;
-               break;
-            case 1:
-               *val = two;
-               break;
-            case 2:
-               *val = three;
-               break;
-            case 3:
-               *val = four;
-               break;
-         }
+         status = asynOverflow;
+         break;
+      }
+
+      epicsTimeGetCurrent(&now);
+      wait = timeout - epicsTimeDiffInSeconds(&now, &start);
+      if(wait <= 0.0)
+      {
+         status = asynTimeout;
+         break;
       }
-      /* The rest of the supported models respond the same.                   */
-      else if(c_p_->ArcusModel != arcusController::UNKNOWN)
+      gapWait = (rxLen_ > 0) && frameOnGap() && (wait > FRAME_GAP);
+      if(gapWait)
+         wait = FRAME_GAP;
+
+      nread = 0;
+      eomReason = 0;
+      status = pasynOctetSyncIO->read(asynUserMot_p_, rxBuf_ + rxLen_,
+                  sizeof(rxBuf_) - rxLen_, wait, &nread, &eomReason);
+      rxLen_ += nread;
+      if(eomReason & ASYN_EOM_EOS)
       {
-         sscanf(rbuf, "%d", &one);
-         *val = one;
+         complete = true;   /* The EOS layer has already removed it.          */
+         eosSeen_ = true;
       }
+      else if((status == asynTimeout) && (nread == 0) && gapWait)
+         complete = true;   /* Line went quiet after a terminator-less reply. */
+      else if((status != asynSuccess) && (status != asynTimeout))
+         break;
+      status = asynSuccess;
    }
 
+   /* Hand over the reply, i bytes long, without its terminator.              */
+   n = (i < (size_t)len) ? i : (size_t)len - 1;
+   memcpy(rep, rxBuf_, n);
+   rep[n] = 0;
+   *got_p = n;
+   if((status == asynSuccess) && (n < i))
+      status = asynOverflow;
+   if(i < rxLen_)
+      i++;              /* Drop the terminator too.                           */
+   rxLen_ -= i;
+   memmove(rxBuf_, rxBuf_ + i, rxLen_);
+
    return(status);
 }
 
-/* Read a parameter from the ARCUS (nothing to do with asyn's parameter
- * library).
- *
- * parm_cmd: ARCUS command to read parameter
- * val_p:    where to store the value returned by the MCS
- * 
- * RETURNS:  asynError if an error occurred, asynSuccess otherwise.
- */
- /*
-asynStatus arcusAxis::getVal(const char *parm_cmd, int *val_p)
+/* One write/read exchange with the controller, no retries.                  */
+asynStatus arcusController::writeReadOnce(size_t *got_p, char *rep, int len,
+    double timeout, const char *cmd, int cmdLen)
 {
-   char       rep[REP_LEN];
-   char       cmd[CMD_LEN];
-   size_t     cmd_len, rep_len;
-   asynStatus st;
-   //int        ax;
+   size_t     nwrite;
+   asynStatus status;
 
-	sprintf(cmd, "%s", parm_cmd);
-   cmd_len = strlen(cmd);
-	st = c_p_->sendCmd(&rep_len, rep, sizeof(rep), 1.0, cmd, cmd_len);
-	
-	return(st);
-	//return c_p_->parseReply(rep, &ax, val_p) ? asynError: asynSuccess;
+   *got_p = 0;
+   /* Anything still buffered belongs to an earlier, abandoned exchange.      */
+   rxLen_ = 0;
+   pasynOctetSyncIO->flush(asynUserMot_p_);
+   status = pasynOctetSyncIO->write(asynUserMot_p_, cmd, cmdLen, timeout,
+                                    &nwrite);
+   if(status != asynSuccess)
+      return(status);
+   txCmds_++;
+   txRoundTrips_++;
+   status = readFrame(got_p, rep, len, timeout);
+   if(status == asynTimeout)
+      epicsAtomicIncrSizeT(&timeoutCount_);
+   return(status);
 }
-*/
 
-/* Polling for current position, status. For now, check all encoder values.   */
-asynStatus arcusAxis::poll(bool *moving_p)
+/* A command ran out of retries. Cycle the connection once and hold off any   */
+/* further attempts, doubling the hold-off each time the link stays down.     */
+void arcusController::linkDown()
 {
-   int val;
-   enum arcusPMXStatus PMXStatus;
-   enum arcusDMXStatus DMXStatus;
+   asynStatus status;
 
-	if((comStatus_ = getEncoderVal(axis_, &val)))
+   if(linkState_ == LINK_DOWN)
    {
-		setIntegerParam(c_p_->motorStatusProblem_,    comStatus_ ? 1 : 0 );
-	   setIntegerParam(c_p_->motorStatusCommsError_, comStatus_ ? 1 : 0 );
-      callParamCallbacks();
-   	return(comStatus_);
+      holdOff_ *= 2.0;
+      if(holdOff_ > backoffMax_)
+         holdOff_ = backoffMax_;
    }
-	setDoubleParam(c_p_->motorEncoderPosition_, (double)val);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\narcusAxis: Encoder value for %c is %d\n", channel_, val);
-
-   if((comStatus_ = getPositionVal(axis_, &val)))
+   else
    {
-		setIntegerParam(c_p_->motorStatusProblem_,    comStatus_ ? 1 : 0 );
-	   setIntegerParam(c_p_->motorStatusCommsError_, comStatus_ ? 1 : 0 );
-      callParamCallbacks();
-   	return(comStatus_);
+      holdOff_ = RECONNECT_HOLDOFF;
+      asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+         "arcusController(%s): link down, reconnecting\n", portName);
+   }
+   linkState_ = LINK_DOWN;
+   linkGeneration_++;
+   epicsAtomicIncrSizeT(&reconnectCount_);
+
+   status = pasynCommonSyncIO->disconnectDevice(asynUserCommonMot_p_);
+   if (status != asynSuccess) {
+      asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+                        "Warning -- unable to disconnect from device\n");
+   }
+   status = pasynCommonSyncIO->connectDevice(asynUserCommonMot_p_);
+   if (status != asynSuccess) {
+      asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+                           "Warning -- unable to reconnect to device\n");
    }
-	setDoubleParam(c_p_->motorPosition_, (double)val);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\narcusAxis: Position value for %c is %d\n", channel_, val);
 
-   comStatus_ = getAxisStatus(axis_, &val);
+   epicsTimeGetCurrent(&nextReconnect_);
+   epicsTimeAddSeconds(&nextReconnect_, holdOff_);
+}
 
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
+/* Queue priority of a command class, 0 first, see submit().                  */
+#define IO_PRIO_QUERY (NUM_IO_PRIO - 1)
+static int arcusIoPriority(arcusCmdClass_t cls)
+{
+   switch(cls)
    {
-      PMXStatus = (arcusPMXStatus)val;
-      switch(PMXStatus)
+      case CLASS_STOP:
+         return(0);
+      case CLASS_STATUS:
+      case CLASS_ENCODER:
+      case CLASS_POSITION:
+         return(IO_PRIO_QUERY);
+      default:
+         return(1);
+   }
+}
+
+static void arcusIoThreadC(void *pPvt)
+{
+   ((arcusController *)pPvt)->ioThread();
+}
+
+/* All controller I/O goes through one thread per controller, taking the      */
+/* queued requests stops first, then other commands, then status queries.     */
+/* Once it is running, the poller gives up the controller lock while its      */
+/* queries wait, so that a stop or move can be queued ahead of the rest of    */
+/* the poll cycle instead of waiting behind it.                               */
+void arcusController::startIoThread()
+{
+   ioThreadId_ = epicsThreadCreate("arcusIO", epicsThreadPriorityHigh,
+      epicsThreadGetStackSize(epicsThreadStackMedium), arcusIoThreadC, this);
+}
+
+void arcusController::ioThread()
+{
+   arcusIoRequest *req;
+   int            prio;
+
+   for(;;)
+   {
+      epicsMutexMustLock(ioLock_);
+      for(prio = 0; (prio < NUM_IO_PRIO) && !ioHead_[prio]; prio++)
+         ;
+      if(prio == NUM_IO_PRIO)
+      {
+         epicsMutexUnlock(ioLock_);
+         epicsEventMustWait(ioWake_);
+         continue;
+      }
+      req = ioHead_[prio];
+      if(!(ioHead_[prio] = req->next))
+         ioTail_[prio] = 0;
+      if(prio < IO_PRIO_QUERY)
+         epicsAtomicDecrIntT(&urgentQueued_);
+      epicsMutexUnlock(ioLock_);
+
+      if(req->nCmds)
+         req->status = sendCmdsNow(req->nCmds, req->cmds, req->cmdStatus,
+                                   req->cls);
+      else
+         req->status = sendCmdNow(req->got_p, req->rep, req->len,
+                                  req->timeout, req->cmd, req->cmdLen,
+                                  req->cls, req->once);
+      epicsEventSignal(req->done);
+   }
+}
+
+/* Hand a request to the I/O thread and wait for it; before the thread is     */
+/* started, and on the thread itself, just do it.                             */
+asynStatus arcusController::submit(arcusIoRequest *req)
+{
+   epicsThreadId self = epicsThreadGetIdSelf();
+   int           prio = arcusIoPriority(req->cls);
+   bool          yield = (prio == IO_PRIO_QUERY) && (self == pollerId_);
+
+   if(!ioThreadId_ || (self == ioThreadId_))
+   {
+      if(req->nCmds)
+         return(sendCmdsNow(req->nCmds, req->cmds, req->cmdStatus, req->cls));
+      return(sendCmdNow(req->got_p, req->rep, req->len, req->timeout,
+                        req->cmd, req->cmdLen, req->cls, req->once));
+   }
+   if(!(req->done = (epicsEventId)epicsThreadPrivateGet(arcusIoDoneId)))
+   {
+      req->done = epicsEventMustCreate(epicsEventEmpty);
+      epicsThreadPrivateSet(arcusIoDoneId, req->done);
+   }
+   req->next = 0;
+   epicsMutexMustLock(ioLock_);
+   if(ioTail_[prio])
+      ioTail_[prio]->next = req;
+   else
+      ioHead_[prio] = req;
+   ioTail_[prio] = req;
+   if(prio < IO_PRIO_QUERY)
+      epicsAtomicIncrIntT(&urgentQueued_);
+   epicsMutexUnlock(ioLock_);
+   epicsEventSignal(ioWake_);
+   if(prio < IO_PRIO_QUERY)
+      epicsEventSignal(urgentWake_);
+
+   if(yield)
+      unlock();
+   epicsEventMustWait(req->done);
+   if(yield)
+      lock();
+   return(req->status);
+}
+
+/* Every command and query to the controller goes through here.               */
+/* got_p   - Number of bytes read.                                            */
+/* rep     - The buffer holding the response.                                 */
+/* len     - The length of the response buffer.                               */
+/* timeout - Obvious                                                          */
+/* cmd     - The command to send, already formatted.                          */
+/* cmsLen  - The llength of the command being sent.                           */
+/*                                                                            */
+/* A failed exchange is retried up to retries_ times with an exponentially    */
+/* growing delay. While the link is DOWN, status queries fail at once with    */
+/* asynDisconnected until the reconnect hold-off has passed; anything else,   */
+/* a stop above all, is still written once in case the link is back.          */
+/* The exchange is done by sendCmdNow() on the I/O thread, see submit().      */
+asynStatus arcusController::sendCmd(size_t *got_p, char *rep, int len,
+    double timeout, const char *cmd, int cmdLen, arcusCmdClass_t cls)
+{
+   arcusIoRequest req;
+
+   req.nCmds   = 0;
+   req.got_p   = got_p;
+   req.rep     = rep;
+   req.len     = len;
+   req.timeout = timeout;
+   req.cmd     = cmd;
+   req.cmdLen  = cmdLen;
+   req.cls     = cls;
+   req.once    = false;
+   return(submit(&req));
+}
+
+/* A command that isn't the driver's own, from a client of the proxy. It is   */
+/* queued like sendCmd()'s but written once, and a missing reply is left to   */
+/* the client: it neither retries nor takes the link SUSPECT or DOWN, so a    */
+/* client sending rubbish can't cut the driver off its controller.            */
+asynStatus arcusController::sendCmdOnce(size_t *got_p, char *rep, int len,
+    double timeout, const char *cmd, int cmdLen, arcusCmdClass_t cls)
+{
+   arcusIoRequest req;
+
+   req.nCmds   = 0;
+   req.got_p   = got_p;
+   req.rep     = rep;
+   req.len     = len;
+   req.timeout = timeout;
+   req.cmd     = cmd;
+   req.cmdLen  = cmdLen;
+   req.cls     = cls;
+   req.once    = true;
+   return(submit(&req));
+}
+
+asynStatus arcusController::sendCmds(int nCmds, const char * const *cmds,
+    asynStatus *cmdStatus, arcusCmdClass_t cls)
+{
+   arcusIoRequest req;
+
+   req.nCmds     = nCmds;
+   req.cmds      = cmds;
+   req.cmdStatus = cmdStatus;
+   req.cls       = cls;
+   req.once      = false;
+   return(submit(&req));
+}
+
+/* The retries of a status query are given up as soon as anything else is     */
+/* queued, so a stop never waits out a query's back-off on a bad link. With   */
+/* once set there are no retries and a failure leaves the link state alone,   */
+/* see sendCmdOnce().                                                         */
+asynStatus arcusController::sendCmdNow(size_t *got_p, char *rep, int len,
+    double timeout, const char *cmd, int cmdLen, arcusCmdClass_t cls,
+    bool once)
+{
+   asynStatus     status;
+   epicsTimeStamp start;
+   double         delay = backoffMin_;
+   int            maxPass = once ? 0 : retries_;
+   int            pass;
+
+   *got_p = 0;
+   epicsTimeGetCurrent(&start);
+   if(linkState_ == LINK_DOWN)
+   {
+      if((arcusIoPriority(cls) == IO_PRIO_QUERY) &&
+         (epicsTimeDiffInSeconds(&nextReconnect_, &start) > 0.0))
+      {
+         noteCmd(cls, asynDisconnected, &start);
+         return(asynDisconnected);
+      }
+      maxPass = 0;   /* Just probe the link.                                  */
+   }
+
+   for(pass = 0; ; pass++)
+   {
+      status = writeReadOnce(got_p, rep, len, timeout, cmd, cmdLen);
+      if(status == asynSuccess)
+      {
+         if(linkState_ != LINK_UP)
+            asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+               "arcusController(%s): link up\n", portName);
+         linkState_ = LINK_UP;
+         if(cache_ && (arcusIoPriority(cls) == IO_PRIO_QUERY))
+            cacheReply(cmd, cmdLen, rep, *got_p);
+         noteCmd(cls, status, &start);
+         return(status);
+      }
+      asynPrint(asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+               "sendCmd(\"%s\"), status:%d, inCount:%d, pass:%d\n",
+                                               cmd, status, (int)*got_p, pass);
+      if(pass >= maxPass) break;
+      epicsAtomicIncrSizeT(&retryCount_);
+      linkState_ = LINK_SUSPECT;
+      if(arcusIoPriority(cls) == IO_PRIO_QUERY)
+      {
+         /* A stop or move is waiting, or turns up during the back-off: give  */
+         /* up on this query, leaving the link SUSPECT rather than DOWN.      */
+         epicsEventTryWait(urgentWake_);
+         if(epicsAtomicGetIntT(&urgentQueued_) ||
+            (epicsEventWaitWithTimeout(urgentWake_, delay) == epicsEventOK))
+         {
+            noteCmd(cls, status, &start);
+            return(status);
+         }
+      }
+      else
+         epicsThreadSleep(delay);
+      delay *= 2.0;
+      if(delay > backoffMax_)
+         delay = backoffMax_;
+   }
+
+   noteCmd(cls, status, &start);
+   if(!once)
+      linkDown();
+	return status;
+}
+
+/* Send a sequence of commands. On the Ethernet controllers, with pipelining */
+/* on, all of them are written back to back and the replies collected in     */
+/* order afterwards, so the sequence costs about one round trip. That needs  */
+/* replies with a terminator: a DMX-ETH replying without one is framed by a  */
+/* quiet line, which replies sent back to back never leave, so it is only    */
+/* pipelined once a terminated reply has been seen. The serial DMX-K-SA bus  */
+/* is always driven one command at a time. cmdStatus[i] gets the outcome of  */
+/* cmds[i]; a reply starting with '?' means the controller rejected the      */
+/* command. If a pipelined reply goes missing, the commands already written  */
+/* are not sent again (an INC move would run twice): they and the rest are   */
+/* marked failed and left to the caller. Returns the first failing status.   */
+asynStatus arcusController::sendCmdsNow(int nCmds, const char * const *cmds,
+    asynStatus *cmdStatus, arcusCmdClass_t cls)
+{
+   char       rep[REP_LEN];
+   size_t     got, nwrite;
+   asynStatus status = asynSuccess;
+   epicsTimeStamp start;
+   int        nSent = 0, nDone = 0;
+   int        i;
+
+   if(pipeline_ && (nCmds > 1) && (linkState_ == LINK_UP) &&
+      ((ArcusModel == PMX_4ET_SA) || ((ArcusModel == DMX_ETH) && eosSeen_)))
+   {
+      epicsTimeGetCurrent(&start);
+      rxLen_ = 0;
+      pasynOctetSyncIO->flush(asynUserMot_p_);
+      for(nSent = 0; nSent < nCmds; nSent++)
+      {
+         if(pasynOctetSyncIO->write(asynUserMot_p_, cmds[nSent],
+               strlen(cmds[nSent]), DEFLT_TIMEOUT, &nwrite) != asynSuccess)
+            break;
+      }
+      txCmds_ += nSent;
+      if(nSent > 0)
+         txRoundTrips_++;
+      for(nDone = 0; nDone < nSent; nDone++)
       {
-         default:
-            *moving_p = false;
+         cmdStatus[nDone] = readFrame(&got, rep, sizeof(rep), DEFLT_TIMEOUT);
+         if(cmdStatus[nDone] != asynSuccess)
             break;
-         case PMX_Accelerating:
-         case PMX_Constant_Spd:
-         case PMX_Decelerating:
-            *moving_p = true;
+         noteCmd(cls, (rep[0] == '?') ? asynError : asynSuccess, &start);
+         if(rep[0] == '?')
+         {
+            asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+               "sendCmds(\"%s\"): rejected (%s)\n", cmds[nDone], rep);
+            cmdStatus[nDone] = asynError;
+            if(status == asynSuccess)
+               status = asynError;
+         }
+      }
+      ARCUS_TRACE(this, ARCUS_TRACE_CMD,
+         "sendCmds: %d of %d pipelined\n", nDone, nCmds);
+      if((nSent > 0) && (nDone < nCmds))
+      {
+         /* cmds[nDone] went out unanswered, or a write failed before it.    */
+         if(nDone < nSent)
+            noteCmd(cls, cmdStatus[nDone], &start);
+         else
+            cmdStatus[nDone] = asynError;
+         if(status == asynSuccess)
+            status = cmdStatus[nDone];
+         for(i = nDone + 1; i < nCmds; i++)
+            cmdStatus[i] = asynError;
+         asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+            "sendCmds: %d of %d pipelined commands unanswered, not resent\n",
+            nSent - nDone, nCmds);
+         linkState_ = LINK_SUSPECT;   /* No pipelining until a good reply.    */
+         rxLen_ = 0;
+         pasynOctetSyncIO->flush(asynUserMot_p_);
+         return(status);
+      }
+   }
+
+   for(i = nDone; i < nCmds; i++)
+   {
+      cmdStatus[i] = sendCmdNow(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmds[i],
+                                strlen(cmds[i]), cls);
+      if((cmdStatus[i] == asynSuccess) && (rep[0] == '?'))
+      {
+         asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+            "sendCmds(\"%s\"): rejected (%s)\n", cmds[i], rep);
+         cmdStatus[i] = asynError;
+      }
+      if(cmdStatus[i] != asynSuccess)
+      {
+         /* Don't carry on with the rest of a half-failed sequence.           */
+         status = cmdStatus[i];
+         for(i++; i < nCmds; i++)
+            cmdStatus[i] = asynError;
          break;
       }
    }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
+
+   return(status);
+}
+
+asynStatus arcusController::setPipelining(int enable)
+{
+   lock();
+   pipeline_ = (enable != 0);
+   unlock();
+   return(asynSuccess);
+}
+
+asynStatus arcusController::setRetryPolicy(int retries, double backoffMin,
+    double backoffMax)
+{
+   if((retries < 0) || (backoffMin < 0.0) || (backoffMax < backoffMin))
+      return(asynError);
+   lock();
+   retries_    = retries;
+   backoffMin_ = backoffMin;
+   backoffMax_ = backoffMax;
+   unlock();
+   return(asynSuccess);
+}
+
+void arcusController::report(FILE *fp, int level)
+{
+   int i, b;
+
+   fprintf(fp, "Arcus controller %s, model %s, link %s\n", portName,
+      ControllerTypeStrings[ArcusModel], LinkStateStrings[linkState_]);
+   if(level > 0)
+   {
+      fprintf(fp, "  retries %d, backoff %g..%g s, reconnect hold-off %g s\n",
+         retries_, backoffMin_, backoffMax_, holdOff_);
+      fprintf(fp, "  pipelining %s, trace level %d, position deadband %d\n",
+         pipeline_ ? "on" : "off", traceLevel_, positionDeadband_);
+      if(ArcusModel == DMX_K_SA)
+         fprintf(fp, "  idle axes polled per cycle while moving %d\n",
+            idleAxesPerCycle_);
+      fprintf(fp, "  moving poll period %g s (configured %g s), guard %g s\n",
+         movingPollPeriod_, densePollPeriod_, pollGuard_);
+      fprintf(fp, "  retries %lu, reconnects %lu, timeouts %lu\n",
+         (unsigned long)epicsAtomicGetSizeT(&retryCount_),
+         (unsigned long)epicsAtomicGetSizeT(&reconnectCount_),
+         (unsigned long)epicsAtomicGetSizeT(&timeoutCount_));
+   }
+   if(level > 1)
    {
-      DMXStatus = (arcusDMXStatus)val;
-      switch(DMXStatus)
+      fprintf(fp, "  %-9s %9s %7s  latency histogram (ms: <0.5 <1 <2 <5 <10 "
+         "<20 <50 <100 <200 <500 <1000 more)\n", "class", "commands",
+         "errors");
+      for(i = 0; i < NUM_CMD_CLASSES; i++)
       {
-         default:
-            *moving_p = false;
-            break;
-         case DMX_Accelerating:
-         case DMX_Constant_Spd:
-         case DMX_Decelerating:
-            *moving_p = true;
+         fprintf(fp, "  %-9s %9lu %7lu ", arcusCmdClassStrings[i],
+            (unsigned long)epicsAtomicGetSizeT(&cmdStats_[i].count),
+            (unsigned long)epicsAtomicGetSizeT(&cmdStats_[i].errors));
+         for(b = 0; b < NUM_LATENCY_BUCKETS; b++)
+            fprintf(fp, " %lu",
+               (unsigned long)epicsAtomicGetSizeT(&cmdStats_[i].hist[b]));
+         fprintf(fp, "\n");
+      }
+   }
+   asynMotorController::report(fp, level);
+}
+
+/* White space allowed around the values of a reply, see arcusParseInts().    */
+static inline bool arcusIsSpace(char c)
+{
+   return((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'));
+}
+
+/* Parse one signed decimal integer starting at *pp, not reading past end.    */
+/* On success *pp is left on the first character after the number.           */
+static arcusParseStatus_t arcusParseInt(const char **pp, const char *end,
+                                        int *val)
+{
+   const char    *p = *pp;
+   unsigned long limit = (unsigned long)INT_MAX;
+   unsigned long u = 0;
+   unsigned long d;
+   bool          neg = false;
+
+   if((p < end) && ((*p == '-') || (*p == '+')))
+   {
+      neg = (*p == '-');
+      if(neg)
+         limit++;
+      p++;
+   }
+   if((p >= end) || (*p < '0') || (*p > '9'))
+      return(PARSE_NOT_NUMBER);
+   for(; (p < end) && (*p >= '0') && (*p <= '9'); p++)
+   {
+      /* Checked before the digit is added, so u itself can never wrap.       */
+      d = (unsigned long)(*p - '0');
+      if(u > (limit - d) / 10)
+         return(PARSE_RANGE);
+      u = u * 10 + d;
+   }
+   *val = neg ? (int)(0 - u) : (int)u;
+   *pp = p;
+   return(PARSE_OK);
+}
+
+/* Parse a reply of exactly nVals colon-separated integers (four for the      */
+/* PMX-4ET-SA's all-axes queries, one for everything else). Reading stops at  */
+/* len or at a NUL, whichever comes first. vals[] is only written if the      */
+/* whole reply is good, so a truncated or garbled reply never leaves a half   */
+/* updated result behind.                                                     */
+arcusParseStatus_t arcusParseInts(const char *rep, size_t len, int *vals,
+                                  int nVals)
+{
+   const char         *p = rep;
+   const char         *end = (const char *)memchr(rep, 0, len);
+   int                tmp[MAX_REPLY_FIELDS];
+   int                i;
+   arcusParseStatus_t status;
+
+   if((nVals < 1) || (nVals > MAX_REPLY_FIELDS))
+      return(PARSE_TOO_FEW);
+   if(!end)
+      end = rep + len;
+   while((p < end) && arcusIsSpace(*p))
+      p++;
+   if(p >= end)
+      return(PARSE_EMPTY);
+   if(*p == '?')
+      return(PARSE_REJECTED);
+   for(i = 0; i < nVals; i++)
+   {
+      if(i > 0)
+      {
+         if(p >= end)
+            return(PARSE_TOO_FEW);
+         if(*p++ != ':')
+            return(PARSE_BAD_SEPARATOR);
+      }
+      if((p >= end) && (i > 0))
+         return(PARSE_TOO_FEW);
+      if((status = arcusParseInt(&p, end, &tmp[i])) != PARSE_OK)
+         return(status);
+   }
+   while((p < end) && arcusIsSpace(*p))
+      p++;
+   if(p < end)
+      return(PARSE_TRAILING);
+   memcpy(vals, tmp, nVals * sizeof(int));
+   return(PARSE_OK);
+}
+
+/* Parse a ":<NAME><axis>,<value>" reply. Returns the value for an error      */
+/* ('E...') reply, 0 for any other good reply and -1 if it is malformed.      */
+int arcusController::parseReply(const char *reply, int *ax_p, int *val_p)
+{
+   const char *p = reply;
+   const char *end = reply + strlen(reply);
+   char       first;
+   int        n, ax, val;
+
+   if(*p++ != ':')
+      return -1;
+   first = *p;
+   for(n = 0; (*p >= 'A') && (*p <= 'Z'); p++)
+      n++;
+   if(n == 0 || n > 9)
+      return -1;
+   if(arcusParseInt(&p, end, &ax) != PARSE_OK || *p++ != ',')
+      return -1;
+   if(arcusParseInt(&p, end, &val) != PARSE_OK)
+      return -1;
+   *ax_p  = ax;
+   *val_p = val;
+	return 'E' == first ? *val_p : 0;
+}
+
+/* Send a query whose reply holds a value for all four axes, such as the      */
+/* PMX-4ET-SA's MST, PE and PP, and return the four values in vals[].         */
+asynStatus arcusController::getAllAxesVal(const char *cmd, int *vals,
+                                          arcusCmdClass_t cls)
+{
+   char       rep[REP_LEN];
+   size_t     got;
+   asynStatus status;
+   arcusParseStatus_t pStatus;
+
+   status = sendCmd(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmd, strlen(cmd),
+                    cls);
+   if(status != asynSuccess)
+      return(status);
+
+   rep[got < sizeof(rep) ? got : sizeof(rep) - 1] = 0;
+   if((pStatus = arcusParseInts(rep, got, vals, 4)) != PARSE_OK)
+   {
+      asynPrint(asynUserMot_p_, ASYN_TRACE_ERROR,
+         "getAllAxesVal(\"%s\"): %s (%s)\n", cmd,
+         arcusParseStatusStrings[pStatus], rep);
+      return(asynError);
+   }
+   return(asynSuccess);
+}
+
+/* The DMX-K-SA drives share one RS-485 line and are polled one after the    */
+/* other, so a long bus makes every axis wait for all the others. While any  */
+/* axis is moving, poll the moving axes in full every cycle and only         */
+/* idleAxesPerCycle_ of the idle ones, taken round robin, with the reduced   */
+/* MST and PX query set. This bounds a moving axis' status latency by the    */
+/* number of moving axes rather than by the number of drives on the bus.     */
+/* With nothing moving, every axis gets the full poll, encoder included, so  */
+/* an idle motor pushed by hand or drifting still shows up.                  */
+void arcusController::scheduleBus()
+{
+   arcusAxis *pAxis;
+   int        nMoving = 0;
+   int        nIdle = 0;
+   int        next = nextIdleAxis_;
+   int        i, n;
+
+   for(i = 0; i < numAxes_; i++)
+      if(pAxes_[i] && pAxes_[i]->moving_)
+         nMoving++;
+
+   for(n = 0; n < numAxes_; n++)
+   {
+      i = (nextIdleAxis_ + n) % numAxes_;
+      pAxis = pAxes_[i];
+      if(!pAxis)
+         continue;
+      if(pAxis->moving_ || (nMoving == 0))
+         pAxis->pollMode_ = arcusAxis::POLL_FULL;
+      else if(nIdle < idleAxesPerCycle_)
+      {
+         pAxis->pollMode_ = arcusAxis::POLL_REDUCED;
+         nIdle++;
+         next = i + 1;
+      }
+      else
+         pAxis->pollMode_ = arcusAxis::POLL_SKIP;
+   }
+   /* Carry on after the last idle axis polled the next time round.           */
+   if(numAxes_ > 0)
+      nextIdleAxis_ = next % numAxes_;
+}
+
+asynStatus arcusController::setBusSchedule(int idleAxesPerCycle)
+{
+   if(idleAxesPerCycle < 0)
+      return(asynError);
+   lock();
+   idleAxesPerCycle_ = idleAxesPerCycle;
+   unlock();
+   return(asynSuccess);
+}
+
+/* Time (s) a move of dist steps should take with the trapezoidal profile    */
+/* the controller runs: start at vmin, ramp to vmax in accel ms (that is how */
+/* the controller reads the ACC value we give it), cruise, ramp back down.   */
+/* A short move that never reaches vmax gets a triangular profile.           */
+double arcusMoveTime(double dist, double vmin, double vmax, double accel)
+{
+   double ta = accel / 1000.0;
+   double rampDist, a, t;
+
+   if(vmax <= 0.0)
+      return(-1.0);
+   if((vmin < 0.0) || (vmin > vmax))
+      vmin = (vmin < 0.0) ? 0.0 : vmax;
+   if((ta <= 0.0) || (vmax == vmin))
+      return(dist / vmax);
+
+   rampDist = (vmin + vmax) / 2.0 * ta;
+   if(2.0 * rampDist <= dist)
+      return(2.0 * ta + (dist - 2.0 * rampDist) / vmax);
+
+   a = (vmax - vmin) / ta;
+   t = (sqrt(vmin * vmin + a * dist) - vmin) / a;
+   return(2.0 * t);
+}
+
+/* Pick the moving poll period for the next cycle. While every moving axis  */
+/* has a predicted end (plain moves, not homing or jogging), there is no    */
+/* point polling during the cruise, so wait until pollGuard_ before the     */
+/* earliest predicted end, no longer than the idle period. Otherwise, and   */
+/* around the end of the move, poll at the configured moving period.        */
+void arcusController::schedulePoll()
+{
+   arcusAxis      *pAxis;
+   epicsTimeStamp now;
+   double         period = densePollPeriod_;
+   double         wait, earliest = -1.0;
+   int            i;
+
+   if((pollGuard_ < 0.0) || (densePollPeriod_ <= 0.0))
+      return;
+   epicsTimeGetCurrent(&now);
+   for(i = 0; i < numAxes_; i++)
+   {
+      pAxis = pAxes_[i];
+      if(!pAxis || !pAxis->moving_)
+         continue;
+      if(!pAxis->predicted_)
+      {
+         earliest = -1.0;
+         break;
+      }
+      wait = epicsTimeDiffInSeconds(&pAxis->predictedEnd_, &now) -
+             pollGuard_ - PREDICT_SLACK * pAxis->moveTime_;
+      if((earliest < 0.0) || (wait < earliest))
+         earliest = wait;
+   }
+   if(earliest > period)
+      period = (earliest < idlePollPeriod_) ? earliest : idlePollPeriod_;
+   movingPollPeriod_ = period;
+}
+
+/* Count a command of class cls that started at start and ended now. Called  */
+/* on every command, so it only touches the atomic counters; publishStats()  */
+/* turns them into parameters from the poller.                               */
+void arcusController::noteCmd(arcusCmdClass_t cls, asynStatus status,
+                              const epicsTimeStamp *start)
+{
+   arcusCmdStats  *st = &cmdStats_[cls];
+   epicsTimeStamp now;
+   double         ms;
+   int            b;
+
+   epicsAtomicIncrSizeT(&st->count);
+   if(status != asynSuccess)
+   {
+      epicsAtomicIncrSizeT(&st->errors);
+      return;
+   }
+   epicsTimeGetCurrent(&now);
+   ms = epicsTimeDiffInSeconds(&now, start) * 1000.0;
+   for(b = 0; b < NUM_LATENCY_BUCKETS - 1; b++)
+      if(ms < arcusLatencyEdges[b])
+         break;
+   epicsAtomicIncrSizeT(&st->hist[b]);
+}
+
+/* Copy the counters to the statistics parameters, at most every            */
+/* STATS_PERIOD. Counts are published modulo 2^31.                           */
+void arcusController::publishStats()
+{
+   epicsTimeStamp now;
+   int            i, b;
+
+   epicsTimeGetCurrent(&now);
+   if(epicsTimeDiffInSeconds(&now, &statsPublished_) < STATS_PERIOD)
+      return;
+   statsPublished_ = now;
+   for(i = 0; i < NUM_CMD_CLASSES; i++)
+   {
+      setIntegerParam(arcusCmdCount_[i],
+         (int)(epicsAtomicGetSizeT(&cmdStats_[i].count) & INT_MAX));
+      setIntegerParam(arcusCmdErrors_[i],
+         (int)(epicsAtomicGetSizeT(&cmdStats_[i].errors) & INT_MAX));
+      for(b = 0; b < NUM_LATENCY_BUCKETS; b++)
+         latencySnap_[i][b] =
+            (epicsInt32)(epicsAtomicGetSizeT(&cmdStats_[i].hist[b]) & INT_MAX);
+      doCallbacksInt32Array(latencySnap_[i], NUM_LATENCY_BUCKETS,
+                            arcusCmdLatency_[i], 0);
+   }
+   setIntegerParam(arcusRetries_,
+      (int)(epicsAtomicGetSizeT(&retryCount_) & INT_MAX));
+   setIntegerParam(arcusReconnects_,
+      (int)(epicsAtomicGetSizeT(&reconnectCount_) & INT_MAX));
+   setIntegerParam(arcusTimeouts_,
+      (int)(epicsAtomicGetSizeT(&timeoutCount_) & INT_MAX));
+   callParamCallbacks(0);
+}
+
+/* Copy the newest n (at most) values of field out of ring, oldest first.     */
+static size_t arcusRingInts(const arcusRing &ring,
+   epicsInt32 arcusSample::*field, epicsInt32 *out, size_t n)
+{
+   size_t count = ring.count();
+   size_t i;
+
+   if(n > count)
+      n = count;
+   for(i = 0; i < n; i++)
+      out[i] = ring.at(count - n + i).*field;
+   return(n);
+}
+
+/* As arcusRingInts(), for the time stamps, in seconds past the EPICS epoch.  */
+static size_t arcusRingTimes(const arcusRing &ring, epicsFloat64 *out,
+   size_t n)
+{
+   size_t count = ring.count();
+   size_t i;
+
+   if(n > count)
+      n = count;
+   for(i = 0; i < n; i++)
+      out[i] = ring.at(count - n + i).time.secPastEpoch +
+               ring.at(count - n + i).time.nsec / 1e9;
+   return(n);
+}
+
+void arcusRing::init(size_t size)
+{
+   delete [] buf_;
+   buf_   = new arcusSample[size];
+   size_  = size;
+   next_  = 0;
+   total_ = 0;
+}
+
+void arcusRing::push(const arcusSample &sample)
+{
+   buf_[next_] = sample;
+   next_ = (next_ + 1) % size_;
+   total_++;
+}
+
+/* Latch arming; everything else goes to the motor record's handling.         */
+asynStatus arcusController::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+   arcusAxis  *pAxis;
+   asynStatus status;
+
+   if(pasynUser->reason != arcusLatchArm_)
+      return(asynMotorController::writeInt32(pasynUser, value));
+   if(!(pAxis = (arcusAxis *)getAxis(pasynUser)))
+      return(asynError);
+   status = pAxis->armLatch(value);
+   pAxis->setIntegerParam(arcusLatchArm_, pAxis->latchMode_);
+   pAxis->callParamCallbacks();
+   return(status);
+}
+
+/* The latency histograms, as last published, the latched positions and the  */
+/* poll history. The rings are only written by poll(), which like this holds  */
+/* the port lock, so a read always sees whole samples.                        */
+asynStatus arcusController::readInt32Array(asynUser *pasynUser,
+    epicsInt32 *value, size_t nElements, size_t *nIn)
+{
+   int       function = pasynUser->reason;
+   arcusAxis *pAxis;
+   size_t    n;
+   int       i;
+
+   if((function == arcusLatchEncoder_) || (function == arcusLatchPosition_))
+   {
+      if(!(pAxis = (arcusAxis *)getAxis(pasynUser)))
+         return(asynError);
+      *nIn = arcusRingInts(pAxis->latch_, (function == arcusLatchEncoder_) ?
+                &arcusSample::encoder : &arcusSample::position,
+                value, nElements);
+      return(asynSuccess);
+   }
+   if((function == arcusSampleEncoder_) || (function == arcusSamplePosition_) ||
+      (function == arcusSampleStatus_))
+   {
+      if(!(pAxis = (arcusAxis *)getAxis(pasynUser)))
+         return(asynError);
+      *nIn = arcusRingInts(pAxis->samples_,
+                (function == arcusSampleEncoder_) ? &arcusSample::encoder :
+                (function == arcusSamplePosition_) ? &arcusSample::position :
+                &arcusSample::status, value, nElements);
+      return(asynSuccess);
+   }
+   for(i = 0; i < NUM_CMD_CLASSES; i++)
+   {
+      if(function != arcusCmdLatency_[i])
+         continue;
+      n = (nElements < NUM_LATENCY_BUCKETS) ? nElements : NUM_LATENCY_BUCKETS;
+      memcpy(value, latencySnap_[i], n * sizeof(epicsInt32));
+      *nIn = n;
+      return(asynSuccess);
+   }
+   return(asynMotorController::readInt32Array(pasynUser, value, nElements,
+                                              nIn));
+}
+
+/* The latch and poll time stamps.                                            */
+asynStatus arcusController::readFloat64Array(asynUser *pasynUser,
+    epicsFloat64 *value, size_t nElements, size_t *nIn)
+{
+   int       function = pasynUser->reason;
+   arcusAxis *pAxis;
+
+   if((function == arcusLatchTime_) || (function == arcusSampleTime_))
+   {
+      if(!(pAxis = (arcusAxis *)getAxis(pasynUser)))
+         return(asynError);
+      *nIn = arcusRingTimes((function == arcusLatchTime_) ? pAxis->latch_ :
+                pAxis->samples_, value, nElements);
+      return(asynSuccess);
+   }
+   return(asynMotorController::readFloat64Array(pasynUser, value, nElements,
+                                                nIn));
+}
+
+/* While the motor record defers moves, arcusAxis::move() only queues them.  */
+/* Turning deferral off starts everything that was queued.                    */
+asynStatus arcusController::setDeferredMoves(bool defer)
+{
+   if(defer)
+   {
+      deferMoves_ = true;
+      return(asynSuccess);
+   }
+   if(!deferMoves_)
+      return(asynSuccess);
+   deferMoves_ = false;
+   return(flushDeferredMoves());
+}
+
+/* Start the queued moves. On the PMX-4ET-SA, after any speed changes, every  */
+/* queued axis' enable and target go out in a single pipelined burst behind   */
+/* one ABS, so the axes start within one write of each other. The other       */
+/* models have one axis per controller or drive and just move them in turn.   */
+asynStatus arcusController::flushDeferredMoves()
+{
+   char       moveCmd[4][CMD_LEN];
+   const char *cmds[1 + 2 * 4];
+   asynStatus cmdStatus[1 + 2 * 4];
+   arcusAxis  *moved[4];
+   arcusAxis  *pAxis;
+   asynStatus status = asynSuccess, axisStatus;
+   int        nCmds = 1, nMoved = 0;
+   int        i;
+
+   for(i = 0; i < numAxes_; i++)
+   {
+      pAxis = pAxes_[i];
+      if(!pAxis || !pAxis->deferred_)
+         continue;
+      pAxis->deferred_ = false;
+      if(ArcusModel != PMX_4ET_SA)
+      {
+         axisStatus = pAxis->move(pAxis->deferTarget_, 0, pAxis->deferMin_,
+                                  pAxis->deferMax_, pAxis->deferAccel_);
+         if(axisStatus != asynSuccess)
+            status = axisStatus;
+         continue;
+      }
+      if((pAxis->axis_ < 0) || (pAxis->axis_ > 3))
+         continue;
+      pAxis->comStatus_ = pAxis->setSpeed(pAxis->deferMax_, pAxis->deferMin_,
+                                          pAxis->deferAccel_);
+      if(pAxis->comStatus_ != asynSuccess)
+      {
+         /* The move is dropped, not retried at the next flush.               */
+         pAxis->predicted_ = false;
+         status = pAxis->pollError();
+         continue;
+      }
+      cmds[0] = pAxis->cmdTable_[CMD_ABS].str;
+      cmds[nCmds++] = pAxis->cmdTable_[CMD_EO].str;
+      moved[nMoved++] = pAxis;
+   }
+   if(nMoved == 0)
+      return(status);
+
+   for(i = 0; i < nMoved; i++)
+   {
+      moved[i]->axisCmd(moveCmd[i], CMD_MOVE,
+                        (int)rint(moved[i]->deferTarget_));
+      cmds[nCmds++] = moveCmd[i];
+   }
+   axisStatus = sendCmds(nCmds, cmds, cmdStatus, CLASS_MOTION);
+   ARCUS_TRACE(this, ARCUS_TRACE_CMD,
+      "flushDeferredMoves: %d axes, status %d\n", nMoved, axisStatus);
+   if(axisStatus != asynSuccess)
+      status = axisStatus;
+   for(i = 0; i < nMoved; i++)
+   {
+      /* Each axis goes by its own enable and target; the ABS is common.      */
+      pAxis = moved[i];
+      pAxis->comStatus_ = cmdStatus[0];
+      if(pAxis->comStatus_ == asynSuccess)
+         pAxis->comStatus_ = cmdStatus[1 + i];
+      if(pAxis->comStatus_ == asynSuccess)
+         pAxis->comStatus_ = cmdStatus[1 + nMoved + i];
+      if(pAxis->comStatus_ != asynSuccess)
+      {
+         pAxis->predicted_ = false;
+         pAxis->pollError();
+         continue;
+      }
+      /* The last polled position is only where the axis is if it has been    */
+      /* idle since; otherwise leave the end of the move to the poller.       */
+      if(pAxis->moving_ || !pAxis->havePosition_)
+         pAxis->predicted_ = false;
+      else
+         pAxis->predictMove(fabs(pAxis->deferTarget_ - pAxis->lastPosition_),
+                            pAxis->deferMin_, pAxis->deferMax_,
+                            pAxis->deferAccel_);
+      pAxis->moving_ = true;
+      pAxis->startSeq_++;
+      pAxis->jogDir_ = 0;
+   }
+   return(status);
+}
+
+/* Commands written to the controller, and the number of times the driver    */
+/* had to wait for the line to turn around (a pipelined burst counts once).  */
+void arcusController::getTraffic(unsigned long *cmds,
+                                 unsigned long *roundTrips) const
+{
+   *cmds       = txCmds_;
+   *roundTrips = txRoundTrips_;
+}
+
+/* True once sendCmd() may be called without the controller lock, that is   */
+/* once the I/O thread runs (after deferred initialisation, if enabled).     */
+bool arcusController::ioReady() const
+{
+   return(ioThreadId_ != 0);
+}
+
+/* Something other than the driver, a proxy client, wrote to the controller:  */
+/* the speed registers and the motion the axes think they started may no     */
+/* longer be what the controller has, so resend everything next time.        */
+void arcusController::forgetAxisState()
+{
+   int i;
+
+   lock();
+   for(i = 0; i < numAxes_; i++)
+   {
+      if(!pAxes_[i])
+         continue;
+      pAxes_[i]->shadowValid_ = 0;
+      pAxes_[i]->predicted_   = false;
+      pAxes_[i]->jogDir_      = 0;
+      pAxes_[i]->profileDir_  = 0;
+   }
+   unlock();
+}
+
+/* Keep the replies to status queries, so that clients of arcusProxyStart()   */
+/* asking the same within maxAge seconds share the answer the poller, or     */
+/* another client, already got instead of asking the controller again.       */
+asynStatus arcusController::setReplyCache(double maxAge)
+{
+   asynStatus status = asynSuccess;
+
+   epicsMutexMustLock(cacheLock_);
+   if(!cache_)
+      cache_ = (arcusCachedReply *)calloc(REPLY_CACHE_LEN,
+                                          sizeof(arcusCachedReply));
+   if(cache_)
+      cacheAge_ = maxAge;
+   else
+      status = asynError;
+   epicsMutexUnlock(cacheLock_);
+   return(status);
+}
+
+/* Called on the I/O thread with each good reply to a status query. The      */
+/* entry for the same command is replaced, or failing that the oldest.       */
+void arcusController::cacheReply(const char *cmd, int cmdLen, const char *rep,
+                                 size_t got)
+{
+   arcusCachedReply *e, *slot = 0;
+   int i;
+
+   if((cmdLen >= CMD_TMPL_LEN) || (got > ARCUS_RX_LEN))
+      return;
+   epicsMutexMustLock(cacheLock_);
+   for(i = 0; i < REPLY_CACHE_LEN; i++)
+   {
+      e = &cache_[i];
+      if(!strncmp(e->cmd, cmd, cmdLen) && !e->cmd[cmdLen])
+      {
+         slot = e;
          break;
       }
+      if(!slot || !e->cmd[0] ||
+         (slot->cmd[0] && (epicsTimeDiffInSeconds(&e->time, &slot->time) < 0.0)))
+         slot = e;
    }
+   memcpy(slot->cmd, cmd, cmdLen);
+   slot->cmd[cmdLen] = 0;
+   memcpy(slot->rep, rep, got);
+   slot->got = got;
+   epicsTimeGetCurrent(&slot->time);
+   epicsMutexUnlock(cacheLock_);
+}
+
+/* Copy the reply to cmd into rep if one younger than the cache age is kept. */
+bool arcusController::cachedReply(const char *cmd, int cmdLen, char *rep,
+                                  int len, size_t *got_p)
+{
+   epicsTimeStamp now;
+   arcusCachedReply *e;
+   bool found = false;
+   int i;
+
+   if(!cache_ || (cmdLen >= CMD_TMPL_LEN))
+      return(false);
+   epicsTimeGetCurrent(&now);
+   epicsMutexMustLock(cacheLock_);
+   for(i = 0; i < REPLY_CACHE_LEN; i++)
+   {
+      e = &cache_[i];
+      if(strncmp(e->cmd, cmd, cmdLen) || e->cmd[cmdLen])
+         continue;
+      if(epicsTimeDiffInSeconds(&now, &e->time) <= cacheAge_)
+      {
+         *got_p = (e->got < (size_t)len) ? e->got : (size_t)len;
+         memcpy(rep, e->rep, *got_p);
+         found = true;
+      }
+      break;
+   }
+   epicsMutexUnlock(cacheLock_);
+   return(found);
+}
+
+/* The thread poll() last ran on, whose queries give up the lock, see        */
+/* submit(). Something calling poll() by hand puts it back afterwards.        */
+epicsThreadId arcusController::pollerThread() const
+{
+   return(pollerId_);
+}
+
+void arcusController::setPollerThread(epicsThreadId id)
+{
+   pollerId_ = id;
+}
+
+asynStatus arcusController::setPositionDeadband(int deadband)
+{
+   lock();
+   positionDeadband_ = (deadband > 0) ? deadband : 0;
+   unlock();
+   return(asynSuccess);
+}
+
+asynStatus arcusController::setTraceLevel(int level)
+{
+   lock();
+   traceLevel_ = level;
+   unlock();
+   return(asynSuccess);
+}
+
+asynStatus arcusController::setPollGuard(double guard)
+{
+   lock();
+   pollGuard_ = guard;
+   if(pollGuard_ < 0.0)
+      movingPollPeriod_ = densePollPeriod_;
+   unlock();
+   return(asynSuccess);
+}
+
+/* Controller-wide part of the poll cycle, called by the poller before the    */
+/* axes are polled. The PMX-4ET-SA reports every axis in each MST, PE and PP  */
+/* reply, so ask once here and hand the values to the axes instead of having  */
+/* each axis send the same three queries.                                     */
+asynStatus arcusController::poll()
+{
+   int        enc[4], pos[4], sts[4];
+   asynStatus status;
+   arcusAxis *pAxis;
+   int        i;
+
+   pollerId_ = epicsThreadGetIdSelf();
+   schedulePoll();
+   publishStats();
+   if(ArcusModel == DMX_K_SA)
+   {
+      scheduleBus();
+      return(asynSuccess);
+   }
+   if(ArcusModel != PMX_4ET_SA)
+      return(asynSuccess);
+
+   for(i = 0; i < numAxes_; i++)
+      if((pAxis = pAxes_[i]))
+         pAxis->polledSeq_ = pAxis->startSeq_;
+   status = getAllAxesVal("PE", enc, CLASS_ENCODER);
+   if(status == asynSuccess)
+      status = getAllAxesVal("PP", pos, CLASS_POSITION);
+   if(status == asynSuccess)
+      status = getAllAxesVal("MST", sts, CLASS_STATUS);
+
+   for(i = 0; i < numAxes_; i++)
+   {
+      pAxis = pAxes_[i];
+      if(!pAxis || (pAxis->axis_ < 0) || (pAxis->axis_ > 3))
+         continue;
+      pAxis->polled_          = true;
+      pAxis->polledComStatus_ = status;
+      if(status == asynSuccess)
+      {
+         pAxis->polledEncoder_  = enc[pAxis->axis_];
+         pAxis->polledPosition_ = pos[pAxis->axis_];
+         pAxis->polledStatus_   = sts[pAxis->axis_];
+      }
+   }
+
+   return(status);
+}
+
+/* For the Arcus motor controllers, axis 0 corresponds to X, 1-Y, 2-Z, 3-U    */
+/* For now, channel means the same thing.                                     */
+arcusAxis::arcusAxis(class arcusController *cnt_p, int axis, int channel)
+	: asynMotorAxis(cnt_p, axis), c_p_(cnt_p)
+{
+   if(channel == 0)
+   	channel_ = 'X';
+   else if(channel == 1)
+      channel_ = 'Y';
+   else if(channel == 2)
+      channel_ = 'Z';
+   else if(channel == 3)
+      channel_ = 'U';
+   else
+      channel_ = '?';
+   channelNo_ = channel;
    
-	setIntegerParam(c_p_->motorStatusDone_, ! *moving_p );
+   axis_ = axis; /* Need to remember our axis number.                         */
+   polled_ = false;
+   shadowValid_ = 0;
+   shadowGeneration_ = c_p_->linkGeneration_;
+   pollMode_ = POLL_FULL;
+   moving_ = false;
+   haveEncoder_ = false;
+   havePosition_ = false;
+   predicted_ = false;
+   published_ = false;
+   pubError_ = false;
+   deferred_ = false;
+   inProfile_ = false;
+   profileDir_ = 0;
+   latchMode_ = 0;
+   startSeq_ = 0;
+   polledSeq_ = 0;
+   jogDir_ = 0;
+   latch_.init(LATCH_RING_LEN);
+   samples_.init(SAMPLE_RING_LEN);
 
-   if(DEBUG)
-	   asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\narcusAxis: Status for %u is %d\n", axis_, val);
+	asynPrint(/*c_p_->pasynUserSelf*/c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+             "\narcusAxis::arcusAxis -- creating axis %u\n", axis);
+
+   /* With deferred initialisation the controller may not know its model     */
+   /* yet; it probes its axes itself once it does.                           */
+   if(!c_p_->initPending_)
+      probe();
+}
+
+/* Set up the commands for the controller's dialect and check the axis       */
+/* answers.                                                                   */
+void arcusAxis::probe()
+{
+	int val;
+
+   if(c_p_->ArcusModel == arcusController::DMX_K_SA)
+      sprintf(Arcus_Com_Prefix, "@%02d", channelNo_ + 1);
+   else
+      Arcus_Com_Prefix[0] = 0;
+   buildCmdTable();
+
+	comStatus_ = getAxisStatus(axis_, &val);
+   
+   asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+         "\narcusAxis: Status of %u returned %i(%d)\n", axis_, comStatus_, val);
+
+	if(comStatus_ == 0)
+   {
+		setIntegerParam(c_p_->motorStatusHasEncoder_, 1);
+		setIntegerParam(c_p_->motorStatusGainSupport_, 1);
+	}
 
 	callParamCallbacks();
 
+	if(comStatus_)
+   {
+		THROW_(arcusException(MCSCommunicationError,
+         "arcusAxis::arcusAxis -- channel %u ASYN error %i", axis_, comStatus_));
+	}
+}
+
+/* Command text for each arcusAxisCmd_t, one column per dialect. In the      */
+/* templates '$' stands for the axis' RS-485 prefix (empty unless DMX-K-SA),  */
+/* '#' for the channel letter and '&' for the axis number counting from 1.    */
+static const char *arcusCmdDialect[NUM_AXIS_CMDS][2] = {
+   /* PMX-4ET-SA    DMX-ETH, DMX-K-SA                                         */
+   {"MST",          "$MST"},
+   {"PE",           "$EX"},
+   {"PP",           "$PX"},
+   {"ABS",          "$ABS"},
+   {"INC",          "$INC"},
+   {"EO&=1",        "$EO=1"},
+   {"#",            "$X"},
+   {"H#+",          "$H+"},
+   {"H#-",          "$H-"},
+   {"J#+",          "$J+"},
+   {"J#-",          "$J-"},
+   {"STOP#",        "$STOP"},
+   {"HS#=",         "$HSPD="},
+   {"LS#=",         "$LSPD="},
+   {"ACC#=",        "$ACC="},
+   {"P#=",          "$PX="},
+   {"SSPD#=",       "$SSPD="},
+   {"LT#=1",        "$LT=1"},
+   {"LT#=0",        "$LT=0"},
+   {"LTS#",         "$LTS"},
+   {"LTE#",         "$LTE"},
+   {"LTP#",         "$LTP"}
+};
+
+/* Statistics class of each arcusAxisCmd_t.                                   */
+static const arcusCmdClass_t arcusCmdClassOf[NUM_AXIS_CMDS] = {
+   CLASS_STATUS, CLASS_ENCODER, CLASS_POSITION, CLASS_MOTION, CLASS_MOTION,
+   CLASS_MOTION, CLASS_MOTION, CLASS_MOTION, CLASS_MOTION, CLASS_MOTION,
+   CLASS_MOTION, CLASS_STOP, CLASS_SPEED, CLASS_SPEED, CLASS_SPEED,
+   CLASS_OTHER, CLASS_SPEED, CLASS_OTHER, CLASS_OTHER, CLASS_STATUS,
+   CLASS_ENCODER, CLASS_POSITION
+};
+
+/* Expand the dialect table for this axis, so that the hot paths only have to */
+/* copy a fixed string and, for some commands, append a number. The table is  */
+/* left empty for an UNKNOWN controller; nothing is sent to one anyway.       */
+void arcusAxis::buildCmdTable()
+{
+   const char *src;
+   char       *dst;
+   int        col, i;
+
+   col = (c_p_->ArcusModel == arcusController::PMX_4ET_SA) ? 0 : 1;
+   for(i = 0; i < NUM_AXIS_CMDS; i++)
+   {
+      dst = cmdTable_[i].str;
+      if(c_p_->ArcusModel != arcusController::UNKNOWN)
+      {
+         for(src = arcusCmdDialect[i][col]; *src; src++)
+         {
+            if(*src == '$')
+            {
+               strcpy(dst, Arcus_Com_Prefix);
+               dst += strlen(dst);
+            }
+            else if(*src == '#')
+               *dst++ = channel_;
+            else if(*src == '&')
+               *dst++ = (char)('1' + axis_);
+            else
+               *dst++ = *src;
+         }
+      }
+      *dst = 0;
+      cmdTable_[i].len = dst - cmdTable_[i].str;
+   }
+}
+
+/* Write the decimal form of val, NUL terminated, to buf. Returns the number  */
+/* of characters written, terminator not counted.                             */
+static size_t arcusFormatInt(char *buf, long val)
+{
+   char          tmp[24];
+   unsigned long u = (val < 0) ? 0UL - (unsigned long)val : (unsigned long)val;
+   size_t        n = 0, len = 0;
+
+   do
+   {
+      tmp[n++] = (char)('0' + u % 10);
+      u /= 10;
+   } while(u);
+   if(val < 0)
+      buf[len++] = '-';
+   while(n)
+      buf[len++] = tmp[--n];
+   buf[len] = 0;
+   return(len);
+}
+
+/* Build command cmd for this axis in buf (at least CMD_LEN long), appending  */
+/* val to the commands that take a value. Returns the command length.         */
+size_t arcusAxis::axisCmd(char *buf, arcusAxisCmd_t cmd, long val) const
+{
+   size_t len = cmdTable_[cmd].len;
+
+   memcpy(buf, cmdTable_[cmd].str, len + 1);
+   switch(cmd)
+   {
+      case CMD_MOVE:
+      case CMD_HSPD:
+      case CMD_LSPD:
+      case CMD_ACC:
+      case CMD_SET_POS:
+      case CMD_SSPD:
+         len += arcusFormatInt(buf + len, val);
+         break;
+      default:
+         break;
+   }
+   return(len);
+}
+
+/* Send an axis query and pick this axis' value out of the reply. The        */
+/* PMX-4ET-SA is the uniques controller, it answers MST, PE and PP with all   */
+/* four axes.                                                                 */
+asynStatus arcusAxis::getAxisVal(arcusAxisCmd_t cmd, int axis, int *val)
+{
+   asynStatus status;
+   char rbuf[80];
+   size_t inCount;
+   int vals[MAX_REPLY_FIELDS];
+   int nVals = 1;
+   arcusParseStatus_t pStatus;
+
+   status = c_p_->sendCmd(&inCount, rbuf, sizeof(rbuf), DEFLT_TIMEOUT,
+                          cmdTable_[cmd].str, cmdTable_[cmd].len,
+                          arcusCmdClassOf[cmd]);
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_POLL,
+         "\ngetAxisVal(%s): Status = %d, inCount = %lu.\n",
+         cmdTable_[cmd].str, status, (unsigned long)inCount);
+
+   if((status != asynSuccess) ||
+      (c_p_->ArcusModel == arcusController::UNKNOWN))
+      return(status);
+
+   if(inCount >= sizeof(rbuf))
+      inCount = sizeof(rbuf) - 1;
+   rbuf[inCount] = 0;
+   /* The PMX-4ET-SA is the uniques controller. Deal with it.                 */
+   /* The rest of the supported models respond the same.                      */
+   if((c_p_->ArcusModel == arcusController::PMX_4ET_SA) && (cmd <= CMD_POS))
+   {
+      nVals = MAX_REPLY_FIELDS;
+      if((axis < 0) || (axis >= nVals))
+         return(asynError);
+   }
+   else
+      axis = 0;
+   if((pStatus = arcusParseInts(rbuf, inCount, vals, nVals)) != PARSE_OK)
+   {
+      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACE_ERROR,
+         "getAxisVal(%s): %s (%s)\n", cmdTable_[cmd].str,
+         arcusParseStatusStrings[pStatus], rbuf);
+      return(asynError);
+   }
+   *val = vals[axis];
+
+   return(status);
+}
+
+/* Request the Motor Status from the ARCUS controller. This is really a       */
+/* controller function, but each axis should be able to get its own value as  */
+/* well. The status values are different between the PMX and DMX controllers  */
+/* according to the manuals, but that's not what I see in the lab. More later */
+asynStatus arcusAxis::getAxisStatus(int axis, int *val)
+{
+   /* This command is common to all (so far) Arcus controllers??              */
+   return(getAxisVal(CMD_MST, axis, val));
+}
+
+/* Request the encoder value from the controller for given axis.              */
+asynStatus arcusAxis::getEncoderVal(int axis, int *val)
+{
+   /* PE on the PMX-4ET-SA, EX on the DMX models.                             */
+   return(getAxisVal(CMD_ENC, axis, val));
+}
+
+asynStatus arcusAxis::getPositionVal(int axis, int *val)
+{
+   return(getAxisVal(CMD_POS, axis, val));
+}
+
+/* Read a parameter from the ARCUS (nothing to do with asyn's parameter
+ * library).
+ *
+ * parm_cmd: ARCUS command to read parameter
+ * val_p:    where to store the value returned by the MCS
+ * 
+ * RETURNS:  asynError if an error occurred, asynSuccess otherwise.
+ */
+ /*
+asynStatus arcusAxis::getVal(const char *parm_cmd, int *val_p)
+{
+   char       rep[REP_LEN];
+   char       cmd[CMD_LEN];
+   size_t     cmd_len, rep_len;
+   asynStatus st;
+   //int        ax;
+
+	sprintf(cmd, "%s", parm_cmd);
+   cmd_len = strlen(cmd);
+	st = c_p_->sendCmd(&rep_len, rep, sizeof(rep), 1.0, cmd, cmd_len);
+	
+	return(st);
+	//return c_p_->parseReply(rep, &ax, val_p) ? asynError: asynSuccess;
+}
+*/
+
+/* Polling for current position, status. For now, check all encoder values.   */
+/* What was read goes into samples_ as well.                                  */
+asynStatus arcusAxis::poll(bool *moving_p)
+{
+   int enc, pos, val, flags;
+   arcusSample sample;
+   bool usePolled = polled_;
+   PollMode_t mode = pollMode_;
+   unsigned seq = usePolled ? polledSeq_ : startSeq_;
+
+   /* If the controller already fetched our values this cycle, use them.     */
+   polled_ = false;
+   pollMode_ = POLL_FULL;
+   if(mode == POLL_SKIP)
+   {
+      /* The bus scheduler left this idle axis out of this cycle.            */
+      *moving_p = false;
+      return(asynSuccess);
+   }
+   if(usePolled)
+      comStatus_ = polledComStatus_;
+   else if((mode == POLL_REDUCED) && haveEncoder_)
+   {
+      /* Idle axis on a shared bus, the encoder hasn't moved either.         */
+      enc = lastEncoder_;
+      comStatus_ = asynSuccess;
+   }
+   else
+      comStatus_ = getEncoderVal(axis_, &enc);
+	if(comStatus_)
+   	return(pollError());
+   if(usePolled)
+      enc = polledEncoder_;
+   lastEncoder_ = enc;
+   haveEncoder_ = true;
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_POLL,
+         "\narcusAxis: Encoder value for %c is %d\n", channel_, enc);
+
+   if(usePolled)
+      pos = polledPosition_;
+   else if((comStatus_ = getPositionVal(axis_, &pos)))
+   	return(pollError());
+   lastPosition_ = pos;
+   havePosition_ = true;
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_POLL,
+         "\narcusAxis: Position value for %c is %d\n", channel_, pos);
+
+   if(usePolled)
+      val = polledStatus_;
+   else if((comStatus_ = getAxisStatus(axis_, &val)))
+   	return(pollError());
+
+   /* A move started while this poll had given up the lock, so the values    */
+   /* may predate it. Leave them; the next poll, coming soon, reads afresh.  */
+   if(seq != startSeq_)
+   {
+      *moving_p = true;
+      return(asynSuccess);
+   }
+
+   flags = arcusDecodeStatus(c_p_->ArcusModel, val);
+   *moving_p = (flags & ST_MOVING) != 0;
+   moving_ = *moving_p;
+   if(!moving_)
+   {
+      predicted_ = false;
+      jogDir_ = 0;
+   }
+
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_POLL,
+         "\narcusAxis: Status for %u is %d\n", axis_, val);
+
+	publish(enc, pos, flags);
+   epicsTimeGetCurrent(&sample.time);
+   sample.encoder  = enc;
+   sample.position = pos;
+   sample.status   = val;
+   samples_.push(sample);
+   if(latchMode_)
+      pollLatch(val);
+
 	return comStatus_;
 }
 
+/* Hand the motor record what changed since the last publish() and nothing   */
+/* else, so idle axes cost no callbacks. Position and encoder changes within */
+/* the controller's deadband are held back, except when the axis starts or   */
+/* stops moving, so the final position of a move is always exact. flags are  */
+/* the decoded motor status, see arcusDecodeStatus().                        */
+void arcusAxis::publish(int enc, int pos, int flags)
+{
+   int  deadband = c_p_->positionDeadband_;
+   bool moving = (flags & ST_MOVING) != 0;
+   bool force = !published_ || (moving != pubMoving_);
+   bool changed = false;
+
+   if(force || (abs(enc - pubEncoder_) > deadband))
+   {
+      setDoubleParam(c_p_->motorEncoderPosition_, (double)enc);
+      pubEncoder_ = enc;
+      changed = true;
+   }
+   if(force || (abs(pos - pubPosition_) > deadband))
+   {
+      setDoubleParam(c_p_->motorPosition_, (double)pos);
+      pubPosition_ = pos;
+      changed = true;
+   }
+   if(force)
+   {
+      setIntegerParam(c_p_->motorStatusDone_, !moving);
+      pubMoving_ = moving;
+   }
+   if(force || pubError_ || (flags != pubStatus_))
+   {
+      setIntegerParam(c_p_->motorStatusHighLimit_, (flags & ST_HIGH_LIMIT) != 0);
+      setIntegerParam(c_p_->motorStatusLowLimit_,  (flags & ST_LOW_LIMIT) != 0);
+      setIntegerParam(c_p_->motorStatusAtHome_,    (flags & ST_HOME) != 0);
+		setIntegerParam(c_p_->motorStatusProblem_,   (flags & ST_PROBLEM) != 0);
+      pubStatus_ = flags;
+      changed = true;
+   }
+   if(pubError_)
+   {
+	   setIntegerParam(c_p_->motorStatusCommsError_, 0);
+      pubError_ = false;
+   }
+   published_ = true;
+   if(changed)
+   	callParamCallbacks();
+}
+
+/* A poll query or a command failed: flag the axis, once, and report it.      */
+/* The next good poll clears the flags again, see publish().                  */
+asynStatus arcusAxis::pollError()
+{
+   if(!pubError_)
+   {
+		setIntegerParam(c_p_->motorStatusProblem_,    1);
+	   setIntegerParam(c_p_->motorStatusCommsError_, 1);
+      callParamCallbacks();
+      pubError_ = true;
+   }
+   return(comStatus_);
+}
+
+/* Arm the latch input for one capture (mode 1) or for captures until it is  */
+/* disarmed (mode 2, re-armed after each), or disarm it (mode 0).            */
+asynStatus arcusAxis::armLatch(int mode)
+{
+   char           rep[REP_LEN];
+   size_t         got;
+   arcusAxisCmd_t cmd = mode ? CMD_LATCH_ON : CMD_LATCH_OFF;
+
+   if((mode < 0) || (mode > 2) ||
+      (c_p_->ArcusModel == arcusController::UNKNOWN))
+      return(asynError);
+   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), DEFLT_TIMEOUT,
+                              cmdTable_[cmd].str, cmdTable_[cmd].len,
+                              arcusCmdClassOf[cmd]);
+   if(comStatus_ == asynSuccess)
+      latchMode_ = mode;
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
+         "\narmLatch(%d): Status = %d.\n", mode, comStatus_);
+   return(comStatus_);
+}
+
+/* Pick up a latch capture while the latch is armed. Every model is asked     */
+/* with LTS, 2 meaning triggered: the DMX latch bit in MST only follows the   */
+/* input, so it would miss a short pulse and count a held input again on      */
+/* every poll. The positions are the ones the controller latched on the      */
+/* input edge; the time stamp is when the poll noticed, up to one poll       */
+/* period later. In mode 2 the latch is re-armed once LTS has confirmed.     */
+void arcusAxis::pollLatch(int mst)
+{
+   arcusSample sample;
+   int         st;
+
+   if(getAxisVal(CMD_LATCH_STAT, axis_, &st) || (st != 2))
+      return;
+   if(getAxisVal(CMD_LATCH_ENC, axis_, &sample.encoder) ||
+      getAxisVal(CMD_LATCH_POS, axis_, &sample.position))
+      return;
+   epicsTimeGetCurrent(&sample.time);
+   sample.status = mst;
+   latch_.push(sample);
+   if((latchMode_ != 2) || armLatch(2))
+      latchMode_ = 0;
+   publishLatch();
+}
+
+void arcusAxis::publishLatch()
+{
+   epicsInt32   ivals[LATCH_RING_LEN];
+   epicsFloat64 dvals[LATCH_RING_LEN];
+   size_t       n;
+
+   setIntegerParam(c_p_->arcusLatchArm_, latchMode_);
+   setIntegerParam(c_p_->arcusLatchCount_, (int)(latch_.total() & INT_MAX));
+   callParamCallbacks();
+   n = arcusRingInts(latch_, &arcusSample::encoder, ivals, LATCH_RING_LEN);
+   c_p_->doCallbacksInt32Array(ivals, n, c_p_->arcusLatchEncoder_, axisNo_);
+   n = arcusRingInts(latch_, &arcusSample::position, ivals, LATCH_RING_LEN);
+   c_p_->doCallbacksInt32Array(ivals, n, c_p_->arcusLatchPosition_, axisNo_);
+   n = arcusRingTimes(latch_, dvals, LATCH_RING_LEN);
+   c_p_->doCallbacksFloat64Array(dvals, n, c_p_->arcusLatchTime_, axisNo_);
+}
+
 asynStatus arcusAxis::moveCmd(int count)
 {
    char    rep[REP_LEN];
@@ -701,123 +2558,67 @@ asynStatus arcusAxis::moveCmd(int count)
    size_t  got, cmdLen;
    double  tout = DEFLT_TIMEOUT;
 
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   	sprintf(cmd, "%c%d", channel_, count);
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-      sprintf(cmd, "%sX%d", Arcus_Com_Prefix, count);
-   cmdLen = strlen(cmd);
-	comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(comStatus_);
+   cmdLen = axisCmd(cmd, CMD_MOVE, count);
+	comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen,
+                              CLASS_MOTION);
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nmoveCmd: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
 
 	return(comStatus_);
 }
 
 asynStatus arcusAxis::setSpeed(double velocity)
 {
-   //long       vel;
-   char       rep[REP_LEN];
-   char       cmd[CMD_LEN];
-   size_t     got, cmdLen;
-   asynStatus status = asynSuccess;
-   double     tout = DEFLT_TIMEOUT;
-
    /* change speed */
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   {
-      //sprintf(cmd, "HS%c=%ld\0LS%c=%ld\0ACC%c=%ld\0", channel_, (long)velocity,
-      //     channel_, (long)(velocity/10), channel_, (long)(velocity/30));
-      sprintf(cmd, "HS%c=%ld", channel_, (long)velocity);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "LS%c=%ld", channel_, (long)(velocity/10));
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "ACC%c=%ld", channel_, (long)(velocity/30));
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-   {
-      //sprintf(cmd, "HSPD=%ld\0LSPD=%ld\0ACC=%ld\0", (long)velocity,
-      //     (long)(velocity/10), (long)(velocity/30));
-      sprintf(cmd, "%sHSPD=%ld", Arcus_Com_Prefix, (long)velocity);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sLSPD=%ld", Arcus_Com_Prefix, (long)(velocity/10));
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sACC=%ld", Arcus_Com_Prefix, (long)(velocity/30));
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   //cmdLen = strlen(cmd);
-   //status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
-         "\nsetSpeed1: Status = %d.\n", status);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   //if((status == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-   //   status = (asynStatus)0;
-
-	return(status);
+   return(setSpeed(velocity, velocity/10, velocity/30));
 }
 
+/* Set HSPD, LSPD and ACC (HSx, LSx and ACCx on the PMX-4ET-SA). Only the     */
+/* values that differ from what the controller last acknowledged are sent.    */
+/* The shadow copies are dropped whenever the controller link is re-made,     */
+/* since the controller may have been power cycled in the meantime.           */
 asynStatus arcusAxis::setSpeed(double velocity, double lowSpeed, double accel)
 {
-   //long       vel;
    char       rep[REP_LEN];
    char       cmd[CMD_LEN];
    size_t     got, cmdLen;
    asynStatus status = asynSuccess;
    double     tout = DEFLT_TIMEOUT;
+   long       val[SPEED_REGS];
+   int        i;
+
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(status);
+
+   val[0] = (long)velocity;
+   val[1] = (long)lowSpeed;
+   val[2] = (long)accel;
 
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   {
-      //sprintf(cmd, "HS%c=%ld\nLS%c=%ld\nACC%c=%ld\n", channel_, (long)velocity,
-      //        channel_, (long)lowSpeed, channel_, (long)accel);
-      sprintf(cmd, "HS%c=%ld", channel_, (long)velocity);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "LS%c=%ld", channel_, (long)lowSpeed);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "ACC%c=%ld", channel_, (long)accel);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-   {
-      //sprintf(cmd, "HSPD=%ld\nLSPD=%ld\nACC=%ld\n", (long)velocity,
-      //        (long)lowSpeed, (long)accel);
-      sprintf(cmd, "%sHSPD=%ld", Arcus_Com_Prefix, (long)velocity);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sLSPD=%ld", Arcus_Com_Prefix, (long)lowSpeed);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sACC=%ld", Arcus_Com_Prefix, (long)accel);
-      cmdLen = strlen(cmd);
-      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   //cmdLen = strlen(cmd);
-   //status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(shadowGeneration_ != c_p_->linkGeneration_)
+   {
+      shadowValid_      = 0;
+      shadowGeneration_ = c_p_->linkGeneration_;
+   }
+
+   for(i = 0; i < SPEED_REGS; i++)
+   {
+      if((shadowValid_ & (1 << i)) && (shadowSpeed_[i] == val[i]))
+         continue;
+      cmdLen = axisCmd(cmd, (arcusAxisCmd_t)(CMD_HSPD + i), val[i]);
+      status = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen,
+                             CLASS_SPEED);
+      if(status != asynSuccess)
+      {
+         shadowValid_ &= ~(1 << i);
+         break;
+      }
+      shadowSpeed_[i] = val[i];
+      shadowValid_   |= (1 << i);
+   }
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nsetSpeed2: Status = %d.\n", status);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   //if((status == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-   //   status = (asynStatus)0;
    
 	return(status);
 }
@@ -825,133 +2626,98 @@ asynStatus arcusAxis::setSpeed(double velocity, double lowSpeed, double accel)
 asynStatus arcusAxis::move(double position, int relative, double min_vel,
            double max_vel, double accel)
 {
-   char   rep[REP_LEN];
-   char   cmd[CMD_LEN];
-   size_t got, cmdLen;
-   double tout = DEFLT_TIMEOUT;
-   double newMin;
+   char       cmd[CMD_LEN];
+   const char *cmds[3] = {0, 0, cmd};
+   asynStatus cmdStatus[3];
+   double     newMin;
 
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\narcusAxis:move position = %f, min_vel = %f, max_vel = %f, accel = %f\n",
          position, min_vel, max_vel, accel);
    if(min_vel < 100.0)
       newMin = max_vel / 10.0;
    else
       newMin = min_vel;
+   if(c_p_->deferMoves_ && (c_p_->ArcusModel != arcusController::UNKNOWN) &&
+      (!relative || havePosition_))
+   {
+      /* Queued until arcusController::setDeferredMoves(false). A relative    */
+      /* move is turned into an absolute one from the last polled position.   */
+      deferred_    = true;
+      deferTarget_ = relative ? lastPosition_ + position : position;
+      deferMin_    = newMin;
+      deferMax_    = max_vel;
+      deferAccel_  = accel;
+      return(asynSuccess);
+   }
 	comStatus_ = setSpeed(max_vel, newMin, accel);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(comStatus_);
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nmove: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
    if(comStatus_ != 0)
    {
-      if(DEBUG)
-         asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+      ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
             "\narcusAxis:move1 Error setting speed (%d).\n", comStatus_);
-      setIntegerParam(c_p_->motorStatusProblem_, 1);
-		setIntegerParam(c_p_->motorStatusCommsError_, 1);
-		callParamCallbacks();
-      return(comStatus_);
+      return(pollError());
    }
-   if(relative)
-      sprintf(cmd, "%sINC", Arcus_Com_Prefix);
+   cmds[0] = cmdTable_[relative ? CMD_INC : CMD_ABS].str;
+   cmds[1] = cmdTable_[CMD_EO].str;
+   axisCmd(cmd, CMD_MOVE, (int)position);
+   comStatus_ = c_p_->sendCmds(3, cmds, cmdStatus);
+   moving_ = true;
+   startSeq_++;
+   jogDir_ = 0;
+   if(!relative && !havePosition_)
+      predicted_ = false;
    else
-      sprintf(cmd, "%sABS", Arcus_Com_Prefix);
-   cmdLen = strlen(cmd);
-   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   {
-      sprintf(cmd, "EO%d=1", axis_+1);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%c%d", channel_, (int)position);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-   {
-      sprintf(cmd, "%sEO=1", Arcus_Com_Prefix);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sX%d", Arcus_Com_Prefix, (int)position);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-
-   //sprintf(cmd, "%c%f", channel_, position);
-   //cmdLen = strlen(cmd);
-   //comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+      predictMove(fabs(relative ? position : position - lastPosition_),
+                  newMin, max_vel, accel);
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nmove2: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
 	
 	return(comStatus_);
 }
 
-asynStatus arcusAxis::home(double min_vel, double max_vel,
-           double accel, int forwards)
+/* Work out when a move that has just been started should be over, so the    */
+/* poller can leave us alone until shortly before then, see                   */
+/* arcusController::schedulePoll().                                           */
+void arcusAxis::predictMove(double dist, double min_vel, double max_vel,
+                            double accel)
 {
-   char   rep[REP_LEN];
-   char   cmd[CMD_LEN];
-   size_t got, cmdLen;
-   double tout = DEFLT_TIMEOUT;
-   char   direction;
+   predicted_ = false;
+   moveTime_ = arcusMoveTime(dist, min_vel, max_vel, accel);
+   if((comStatus_ == asynSuccess) && (moveTime_ >= 0.0))
+   {
+      epicsTimeGetCurrent(&predictedEnd_);
+      epicsTimeAddSeconds(&predictedEnd_, moveTime_);
+      predicted_ = true;
+   }
+}
 
-   if(max_vel < 0)
-      direction = '-';
-   else
-      direction = '+';
+asynStatus arcusAxis::home(double min_vel, double max_vel,
+           double accel, int forwards)
+{
+   const char *cmds[2];
+   asynStatus cmdStatus[2];
 
 	comStatus_ = setSpeed(max_vel, min_vel, accel);
    if(comStatus_ != 0)
    {
-      setIntegerParam(c_p_->motorStatusProblem_, 1);
-		setIntegerParam(c_p_->motorStatusCommsError_, 1);
-		callParamCallbacks();
-      return(comStatus_);
+      return(pollError());
    }
 
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   {
-      //sprintf(cmd, "EO%d=1\0H%c%c\0", axis_+1, channel_, direction);
-      sprintf(cmd, "EO%d=1", axis_+1);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "H%c%c", channel_, direction);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-   {
-      //sprintf(cmd, "EO=1\0H%c\0", direction);
-      sprintf(cmd, "%sEO=1", Arcus_Com_Prefix);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sH%c", Arcus_Com_Prefix, direction);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   //cmdLen = strlen(cmd);
-   //comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(comStatus_);
+   cmds[0] = cmdTable_[CMD_EO].str;
+   cmds[1] = cmdTable_[(max_vel < 0) ? CMD_HOME_NEG : CMD_HOME_POS].str;
+   comStatus_ = c_p_->sendCmds(2, cmds, cmdStatus);
+   moving_ = true;
+   startSeq_++;
+   jogDir_ = 0;
+   predicted_ = false;
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nhome: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
       
 	return(comStatus_);
 }
@@ -959,140 +2725,87 @@ asynStatus arcusAxis::home(double min_vel, double max_vel,
 asynStatus arcusAxis::stop(double acceleration)
 {
    char       rep[REP_LEN];
-   char       cmd[CMD_LEN];
-   size_t     got, cmdLen;
+   size_t     got;
    double     tout = DEFLT_TIMEOUT;
 
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-      sprintf(cmd, "STOP%c", channel_);
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-      sprintf(cmd, "%sSTOP", Arcus_Com_Prefix);
-   cmdLen = strlen(cmd);
-   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(comStatus_);
+   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout,
+                              cmdTable_[CMD_STOP].str, cmdTable_[CMD_STOP].len,
+                              CLASS_STOP);
+   predicted_ = false;
+   jogDir_ = 0;
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nstop: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
 
 	if(comStatus_)
-   {
-		setIntegerParam(c_p_->motorStatusProblem_, 1);
-		setIntegerParam(c_p_->motorStatusCommsError_, 1);
-		callParamCallbacks();
-	}
+      pollError();
    
 	return comStatus_;
 }
 
+/* Redefine the current position. The position register is written with    */
+/* PX= (Px= on the PMX-4ET-SA), which does not move the motor.               */
 asynStatus arcusAxis::setPosition(double position)
 {
-   char       rep[REP_LEN];
    char       cmd[CMD_LEN];
-   size_t     got, cmdLen;
-   double     tout = DEFLT_TIMEOUT;
+   const char *cmds[3] = {cmdTable_[CMD_EO].str, cmdTable_[CMD_ABS].str, cmd};
+   asynStatus cmdStatus[3];
 
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   {
-      //sprintf(cmd, "EO%d=1\0ABS\0%c%d\0", axis_+1, channel_, (int)position);
-      sprintf(cmd, "EO%d=1", axis_+1);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "ABS");
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      printf(cmd, "%c%d", channel_, (int)position);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-   {
-      //sprintf(cmd, "EO=1\0ABS\0X%d\0", (int)position);
-      sprintf(cmd, "%sEO=1", Arcus_Com_Prefix);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sABS", Arcus_Com_Prefix);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      printf(cmd, "%sX%d", Arcus_Com_Prefix, (int)position);
-      cmdLen = strlen(cmd);
-      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   //cmdLen = strlen(cmd);
-   //comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(comStatus_);
+   axisCmd(cmd, CMD_SET_POS, (int)position);
+   comStatus_ = c_p_->sendCmds(3, cmds, cmdStatus, CLASS_OTHER);
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nsetPosition: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
 
 	if(comStatus_)
-   {
-		setIntegerParam(c_p_->motorStatusProblem_,    1);
-		setIntegerParam(c_p_->motorStatusCommsError_, 1);
-		callParamCallbacks();
-	}
+      pollError();
 	return comStatus_;
 }
 
+/* A new speed for a jog already under way in the same direction is set on   */
+/* the fly with a single SSPD, keeping LSPD and ACC, instead of restarting   */
+/* the jog. Anything else, or a failed SSPD, (re)starts the jog in full.     */
 asynStatus arcusAxis::moveVelocity(double min_vel, double max_vel, double accel)
 {
-   long   speed = (long)rint(fabs(max_vel));
-   char   rep[REP_LEN];
-   char   cmd[CMD_LEN];
-   size_t got, cmdLen;
-   char   direction;
-   double tout = DEFLT_TIMEOUT;
-
-	if(max_vel < 0)
-		direction = '-'; 
-	else
-      direction = '+';
+   long       speed = (long)rint(fabs(max_vel));
+   int        dir = (max_vel < 0) ? -1 : 1;
+   char       rep[REP_LEN];
+   char       cmd[CMD_LEN];
+   size_t     got, cmdLen;
+   const char *cmds[2];
+   asynStatus cmdStatus[2];
 
+   if((jogDir_ == dir) && moving_ && (speed > 0) &&
+      (shadowGeneration_ == c_p_->linkGeneration_) &&
+      (!(shadowValid_ & 2) || (speed >= shadowSpeed_[1])))
+   {
+      cmdLen = axisCmd(cmd, CMD_SSPD, speed);
+      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmd,
+                                 cmdLen, CLASS_SPEED);
+      shadowValid_ &= ~1;        /* HSPD may or may not follow SSPD.        */
+      ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
+            "\nmoveVelocity: SSPD %ld, Status = %d.\n", speed, comStatus_);
+      if(comStatus_ == asynSuccess)
+         return(comStatus_);
+   }
 	comStatus_ = setSpeed((double)speed, min_vel, accel);
    if(comStatus_ != 0)
    {
-      setIntegerParam(c_p_->motorStatusProblem_, 1);
-		setIntegerParam(c_p_->motorStatusCommsError_, 1);
-		callParamCallbacks();
-      return(comStatus_);
+      return(pollError());
    }
-   if(c_p_->ArcusModel == arcusController::PMX_4ET_SA)
-   {
-      //sprintf(cmd, "EO%d=1\0J%c%c\0", channel_, channel_, direction);
-      sprintf(cmd, "EO%d=1", axis_+1);
-      cmdLen = strlen(cmd);
-	   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "J%c%c", channel_, direction);
-      cmdLen = strlen(cmd);
-	   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   else if(c_p_->ArcusModel != arcusController::UNKNOWN)
-   {
-      //sprintf(cmd, "EO=1\0J%c\0", direction);
-      sprintf(cmd, "%sEO=1", Arcus_Com_Prefix);
-      cmdLen = strlen(cmd);
-	   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-      sprintf(cmd, "%sJ%c", Arcus_Com_Prefix, direction);
-      cmdLen = strlen(cmd);
-	   comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   }
-   //cmdLen = strlen(cmd);
-	//comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), tout, cmd, cmdLen);
-   if(DEBUG)
-      asynPrint(c_p_->asynUserMot_p_, ASYN_TRACEIO_DRIVER,
+   if(c_p_->ArcusModel == arcusController::UNKNOWN)
+      return(comStatus_);
+   cmds[0] = cmdTable_[CMD_EO].str;
+   cmds[1] = cmdTable_[(dir < 0) ? CMD_JOG_NEG : CMD_JOG_POS].str;
+   comStatus_ = c_p_->sendCmds(2, cmds, cmdStatus);
+   moving_ = true;
+   startSeq_++;
+   jogDir_ = (comStatus_ == asynSuccess) ? dir : 0;
+   predicted_ = false;
+   ARCUS_TRACE(c_p_, arcusController::ARCUS_TRACE_CMD,
          "\nmoveVelocity: Status = %d.\n", comStatus_);
-   /* Again, with the DMX motors, I'm getting a timeout status even though    */
-   /* the data seems to be good. I'll need to figure that out, but in the mean*/
-   /* time, force the status to be good.                                      */
-   if((comStatus_ == 1) && (c_p_->ArcusModel != arcusController::PMX_4ET_SA))
-      comStatus_ = (asynStatus)0;
 
 	return comStatus_;
 }
@@ -1107,6 +2820,411 @@ asynStatus arcusAxis::moveVelocity(double min_vel, double max_vel, double accel)
 //	return val;
 //}
 
+/* Profile moves. None of the controllers has a trajectory buffer the driver  */
+/* can fill, so the profile is streamed from the host by a thread per         */
+/* controller. Segment i runs from point i to point i+1 and takes             */
+/* profileTimes_[i]. A run of segments in which an axis keeps its direction   */
+/* is one move to the end of the run, started at its first segment; the later */
+/* segments only change the axis' speed on the fly (SSPD). Each point's       */
+/* readback is the pulse position read as the point falls due.                */
+
+/* Shortest segment (s) the host can keep up with.                            */
+#define PROFILE_MIN_TIME 0.02
+/* Status poll period (s) while waiting for axes to stop.                     */
+#define PROFILE_POLL     0.01
+/* Allowance (s) for the approach to the first point and the final stop.      */
+#define PROFILE_SETTLE   30.0
+
+static void arcusProfileThreadC(void *pPvt)
+{
+   ((arcusController *)pPvt)->profileThread();
+}
+
+asynStatus arcusController::initializeProfile(size_t maxPoints)
+{
+   asynStatus status;
+
+   status = asynMotorController::initializeProfile(maxPoints);
+   if((status == asynSuccess) && !profileEvent_)
+   {
+      profileEvent_ = epicsEventMustCreate(epicsEventEmpty);
+      epicsThreadCreate("arcusProfile", epicsThreadPriorityHigh,
+         epicsThreadGetStackSize(epicsThreadStackMedium),
+         arcusProfileThreadC, this);
+   }
+   return(status);
+}
+
+/* The generic build fills in the times of a fixed time profile; check that   */
+/* the result is something the host can stream.                               */
+asynStatus arcusController::buildProfile()
+{
+   char msg[80] = "";
+   int  nPoints, use, nUsed = 0;
+   int  i;
+
+   getIntegerParam(profileNumPoints_, &nPoints);
+   if(!profileEvent_)
+      strcpy(msg, "Profile not initialized, see arcusCreateProfile");
+   else if(ArcusModel == UNKNOWN)
+      strcpy(msg, "Unknown controller");
+   else if((nPoints < 2) || (nPoints > maxProfilePoints_))
+      sprintf(msg, "Need 2 to %d points", maxProfilePoints_);
+   else if(asynMotorController::buildProfile() != asynSuccess)
+      strcpy(msg, "Build failed");
+   else
+   {
+      for(i = 0; i < nPoints - 1; i++)
+      {
+         if(profileTimes_[i] < PROFILE_MIN_TIME)
+         {
+            sprintf(msg, "Segment %d shorter than %g s", i, PROFILE_MIN_TIME);
+            break;
+         }
+      }
+      for(i = 0; i < numAxes_; i++)
+      {
+         use = 0;
+         if(pAxes_[i])
+            getIntegerParam(i, profileUseAxis_, &use);
+         if(use)
+            nUsed++;
+      }
+      if(!msg[0] && !nUsed)
+         strcpy(msg, "No axis in use");
+   }
+   setIntegerParam(profileBuildState_, PROFILE_BUILD_DONE);
+   setIntegerParam(profileBuildStatus_,
+      msg[0] ? PROFILE_STATUS_FAILURE : PROFILE_STATUS_SUCCESS);
+   setStringParam(profileBuildMessage_, msg);
+   callParamCallbacks();
+   return(msg[0] ? asynError : asynSuccess);
+}
+
+asynStatus arcusController::executeProfile()
+{
+   int state, built;
+
+   getIntegerParam(profileExecuteState_, &state);
+   getIntegerParam(profileBuildStatus_, &built);
+   if(!profileEvent_ || (state != PROFILE_EXECUTE_DONE) ||
+      (built != PROFILE_STATUS_SUCCESS))
+      return(asynError);
+   profileAborted_ = false;
+   setIntegerParam(profileExecuteState_, PROFILE_EXECUTE_MOVE_START);
+   setIntegerParam(profileExecuteStatus_, PROFILE_STATUS_UNDEFINED);
+   setStringParam(profileExecuteMessage_, "");
+   callParamCallbacks();
+   epicsEventSignal(profileEvent_);
+   return(asynSuccess);
+}
+
+/* Stop the profile axes now; the thread notices at its next wake-up.         */
+asynStatus arcusController::abortProfile()
+{
+   int state;
+   int i;
+
+   getIntegerParam(profileExecuteState_, &state);
+   if(state == PROFILE_EXECUTE_DONE)
+      return(asynSuccess);
+   profileAborted_ = true;
+   for(i = 0; i < numAxes_; i++)
+      if(pAxes_[i] && pAxes_[i]->inProfile_)
+         pAxes_[i]->stop(0.0);
+   epicsEventSignal(profileEvent_);
+   return(asynSuccess);
+}
+
+/* The readbacks are stored in steps as the profile runs and the generic      */
+/* readback converts them in place, so they can be read back once per run.    */
+asynStatus arcusController::readbackProfile()
+{
+   setIntegerParam(profileReadbackState_, PROFILE_READBACK_BUSY);
+   callParamCallbacks();
+   setIntegerParam(profileNumReadbacks_, profileNumRead_);
+   asynMotorController::readbackProfile();
+   profileNumRead_ = 0;
+   setIntegerParam(profileReadbackState_, PROFILE_READBACK_DONE);
+   setIntegerParam(profileReadbackStatus_, PROFILE_STATUS_SUCCESS);
+   setStringParam(profileReadbackMessage_, "");
+   callParamCallbacks();
+   return(asynSuccess);
+}
+
+void arcusController::profileThread()
+{
+   char msg[80];
+   int  state, status;
+   int  i;
+
+   for(;;)
+   {
+      epicsEventMustWait(profileEvent_);
+      lock();
+      getIntegerParam(profileExecuteState_, &state);
+      if(state == PROFILE_EXECUTE_MOVE_START)
+      {
+         msg[0] = 0;
+         status = runProfile(msg);
+         if(status != PROFILE_STATUS_SUCCESS)
+            for(i = 0; i < numAxes_; i++)
+               if(pAxes_[i] && pAxes_[i]->inProfile_)
+                  pAxes_[i]->stop(0.0);
+         setIntegerParam(profileExecuteState_, PROFILE_EXECUTE_DONE);
+         setIntegerParam(profileExecuteStatus_, status);
+         setStringParam(profileExecuteMessage_, msg);
+         callParamCallbacks();
+      }
+      unlock();
+   }
+}
+
+/* Run the profile built last; called with the lock held, which is released   */
+/* while waiting. Returns a ProfileStatus and, on failure, a message.         */
+int arcusController::runProfile(char *msg)
+{
+   arcusAxis      *pAxis;
+   epicsTimeStamp start, now;
+   double         accel, vmax, v, due = 0.0;
+   int            nPoints, use, status;
+   int            i, j;
+
+   getIntegerParam(profileNumPoints_, &nPoints);
+   getDoubleParam(profileAcceleration_, &accel);
+   accel = (accel > 0.0) ? accel * 1000.0 : 1.0;  /* ACC is in ms.           */
+   profileNumRead_ = 0;
+   for(i = 0; i < numAxes_; i++)
+   {
+      if(!(pAxis = pAxes_[i]))
+         continue;
+      use = 0;
+      getIntegerParam(i, profileUseAxis_, &use);
+      pAxis->inProfile_  = (use != 0);
+      pAxis->profileDir_ = 0;
+   }
+
+   /* Approach the first point at the speed of the fastest segment.           */
+   for(i = 0; i < numAxes_; i++)
+   {
+      if(!(pAxis = pAxes_[i]) || !pAxis->inProfile_)
+         continue;
+      vmax = 1.0;
+      for(j = 0; j < nPoints - 1; j++)
+      {
+         v = fabs(pAxis->profilePositions_[j + 1] -
+                  pAxis->profilePositions_[j]) / profileTimes_[j];
+         if(v > vmax)
+            vmax = v;
+      }
+      if(pAxis->move(pAxis->profilePositions_[0], 0, vmax / 10.0, vmax, accel))
+      {
+         sprintf(msg, "Axis %d: move to start failed", i);
+         return(PROFILE_STATUS_FAILURE);
+      }
+   }
+   if((status = waitProfileAxes(0, PROFILE_SETTLE, msg)) !=
+      PROFILE_STATUS_SUCCESS)
+      return(status);
+
+   setIntegerParam(profileExecuteState_, PROFILE_EXECUTE_EXECUTING);
+   callParamCallbacks();
+   epicsTimeGetCurrent(&start);
+   for(i = 0; i < nPoints; i++)
+   {
+      if(i < nPoints - 1)
+      {
+         /* A new run has to wait until the last one has come to a stop.      */
+         for(j = 0; j < numAxes_; j++)
+         {
+            pAxis = pAxes_[j];
+            if(!pAxis || !pAxis->inProfile_ || !pAxis->profileNewRun(i) ||
+               (i == 0))
+               continue;
+            if((status = waitProfileAxes(pAxis, PROFILE_SETTLE, msg)) !=
+               PROFILE_STATUS_SUCCESS)
+               return(status);
+         }
+         /* New runs go out as one burst, see flushDeferredMoves().           */
+         deferMoves_ = true;
+         for(j = 0; j < numAxes_; j++)
+         {
+            pAxis = pAxes_[j];
+            if(!pAxis || !pAxis->inProfile_)
+               continue;
+            if(pAxis->profileSegment(i, accel))
+            {
+               deferMoves_ = false;
+               sprintf(msg, "Axis %d: segment %d failed", j, i);
+               return(PROFILE_STATUS_FAILURE);
+            }
+         }
+         if(setDeferredMoves(false))
+         {
+            sprintf(msg, "Segment %d failed", i);
+            return(PROFILE_STATUS_FAILURE);
+         }
+         for(j = 0; j < numAxes_; j++)
+            if(pAxes_[j] && pAxes_[j]->inProfile_)
+               pAxes_[j]->predicted_ = false;  /* Speed changes on the fly.  */
+      }
+      if(readProfilePoint(i))
+      {
+         sprintf(msg, "Readback of point %d failed", i);
+         return(PROFILE_STATUS_FAILURE);
+      }
+      setIntegerParam(profileCurrentPoint_, i);
+      callParamCallbacks();
+      if(i == nPoints - 1)
+         break;
+
+      due += profileTimes_[i];
+      epicsTimeGetCurrent(&now);
+      unlock();
+      if(due > epicsTimeDiffInSeconds(&now, &start))
+         epicsEventWaitWithTimeout(profileEvent_,
+            due - epicsTimeDiffInSeconds(&now, &start));
+      lock();
+      if(profileAborted_)
+      {
+         strcpy(msg, "Aborted");
+         return(PROFILE_STATUS_ABORT);
+      }
+   }
+   return(waitProfileAxes(0, PROFILE_SETTLE, msg));
+}
+
+/* Wait until pOnly, or every profile axis if it is 0, has stopped.           */
+int arcusController::waitProfileAxes(arcusAxis *pOnly, double timeout,
+                                     char *msg)
+{
+   arcusAxis      *pAxis;
+   epicsTimeStamp start, now;
+   int            sts[4], mst;
+   bool           moving;
+   int            i;
+
+   epicsTimeGetCurrent(&start);
+   for(;;)
+   {
+      moving = false;
+      if((ArcusModel == PMX_4ET_SA) &&
+         getAllAxesVal("MST", sts, CLASS_STATUS))
+      {
+         strcpy(msg, "Status read failed");
+         return(PROFILE_STATUS_FAILURE);
+      }
+      for(i = 0; i < numAxes_; i++)
+      {
+         pAxis = pAxes_[i];
+         if(!pAxis || !pAxis->inProfile_ || (pOnly && (pAxis != pOnly)))
+            continue;
+         if(ArcusModel == PMX_4ET_SA)
+            mst = ((pAxis->axis_ >= 0) && (pAxis->axis_ < 4)) ?
+                  sts[pAxis->axis_] : 0;
+         else if(pAxis->getAxisStatus(pAxis->axis_, &mst))
+         {
+            sprintf(msg, "Axis %d: status read failed", i);
+            return(PROFILE_STATUS_FAILURE);
+         }
+         if(arcusDecodeStatus(ArcusModel, mst) & ST_MOVING)
+            moving = true;
+      }
+      if(!moving)
+         return(PROFILE_STATUS_SUCCESS);
+
+      unlock();
+      epicsEventWaitWithTimeout(profileEvent_, PROFILE_POLL);
+      lock();
+      if(profileAborted_)
+      {
+         strcpy(msg, "Aborted");
+         return(PROFILE_STATUS_ABORT);
+      }
+      epicsTimeGetCurrent(&now);
+      if(epicsTimeDiffInSeconds(&now, &start) > timeout)
+      {
+         strcpy(msg, "Timed out waiting for the axes to stop");
+         return(PROFILE_STATUS_TIMEOUT);
+      }
+   }
+}
+
+/* Store where the profile axes are as point i falls due.                     */
+asynStatus arcusController::readProfilePoint(int i)
+{
+   arcusAxis  *pAxis;
+   asynStatus status = asynSuccess;
+   int        pos[4], val;
+   int        j;
+
+   if(ArcusModel == PMX_4ET_SA)
+      status = getAllAxesVal("PP", pos, CLASS_POSITION);
+   for(j = 0; (j < numAxes_) && (status == asynSuccess); j++)
+   {
+      pAxis = pAxes_[j];
+      if(!pAxis || !pAxis->inProfile_)
+         continue;
+      if(ArcusModel == PMX_4ET_SA)
+         val = ((pAxis->axis_ >= 0) && (pAxis->axis_ < 4)) ?
+               pos[pAxis->axis_] : 0;
+      else if((status = pAxis->getPositionVal(pAxis->axis_, &val)))
+         break;
+      pAxis->profileReadbacks_[i] = val;
+      pAxis->profileFollowingErrors_[i] = val - pAxis->profilePositions_[i];
+   }
+   if(status == asynSuccess)
+      profileNumRead_ = i + 1;
+   return(status);
+}
+
+/* Whether profile segment i starts a new run for this axis, see             */
+/* profileSegment().                                                          */
+bool arcusAxis::profileNewRun(int i) const
+{
+   double dist = profilePositions_[i + 1] - profilePositions_[i];
+
+   return((dist != 0.0) && ((dist > 0.0 ? 1 : -1) != profileDir_));
+}
+
+/* Command segment i of the profile. The first segment of a run moves to the  */
+/* end of the run; the others change the speed on the fly.                    */
+asynStatus arcusAxis::profileSegment(int i, double accel)
+{
+   char   rep[REP_LEN];
+   char   cmd[CMD_LEN];
+   size_t got, cmdLen;
+   double *pos = profilePositions_;
+   double dist = pos[i + 1] - pos[i];
+   double speed;
+   int    dir, nPoints;
+   int    j;
+
+   if(dist == 0.0)
+   {
+      profileDir_ = 0;
+      return(asynSuccess);
+   }
+   dir = (dist > 0.0) ? 1 : -1;
+   speed = rint(fabs(dist) / c_p_->profileTimes_[i]);
+   if(speed < 1.0)
+      speed = 1.0;
+   if(dir == profileDir_)
+   {
+      cmdLen = axisCmd(cmd, CMD_SSPD, (long)speed);
+      comStatus_ = c_p_->sendCmd(&got, rep, sizeof(rep), DEFLT_TIMEOUT, cmd,
+                                 cmdLen, CLASS_SPEED);
+      shadowValid_ &= ~1;        /* HSPD may or may not follow SSPD.        */
+      return(comStatus_);
+   }
+   c_p_->getIntegerParam(c_p_->profileNumPoints_, &nPoints);
+   for(j = i + 1; j < nPoints - 1; j++)
+      if((pos[j + 1] - pos[j]) * dir <= 0.0)
+         break;
+   profileDir_ = dir;
+   return(move(pos[j], 0, speed / 10.0, speed, accel));
+}
+
 /* iocsh wrapping and registration business (stolen from ACRMotorDriver.cpp) */
 static const iocshArg cc_a0 = {"Port name [string]",              iocshArgString};
 static const iocshArg cc_a1 = {"I/O port name [string]",          iocshArgString};
@@ -1114,9 +3232,12 @@ static const iocshArg cc_a2 = {"Number of axes [int]",            iocshArgInt};
 static const iocshArg cc_a3 = {"Moving poll period (s) [double]", iocshArgDouble};
 static const iocshArg cc_a4 = {"Idle poll period (s) [double]",   iocshArgDouble};
 static const iocshArg cc_a5 = {"Arcus Controller Flag [int]",     iocshArgInt};
+static const iocshArg cc_a6 = {"Max baud rate [int]",             iocshArgInt};
+static const iocshArg cc_a7 = {"Store baud rate [int]",           iocshArgInt};
+static const iocshArg cc_a8 = {"Model [string]",                  iocshArgString};
 
 static const iocshArg * const cc_as[] = {&cc_a0, &cc_a1, &cc_a2, &cc_a3, &cc_a4,
-             &cc_a5};
+             &cc_a5, &cc_a6, &cc_a7, &cc_a8};
 
 static const iocshFuncDef cc_def = {"arcusCreateController",
              sizeof(cc_as)/sizeof(cc_as[0]), cc_as};
@@ -1127,7 +3248,10 @@ extern "C" void *arcusCreateController(
 	int         numAxes,
 	double      movingPollPeriod,
 	double      idlePollPeriod,
-   int         ArcusControllerFlag)
+   int         ArcusControllerFlag,
+   int         maxBaud,
+   int         storeBaud,
+   const char *model)
 {
    void *rval = 0;
    
@@ -1139,7 +3263,8 @@ extern "C" void *arcusCreateController(
    {
 #endif
 		rval = new arcusController(motorPortName, ioPortName, numAxes,
-             movingPollPeriod, idlePollPeriod, ArcusControllerFlag);
+             movingPollPeriod, idlePollPeriod, ArcusControllerFlag, maxBaud,
+             storeBaud, model);
 #ifdef ASYN_CANDO_EXCEPTIONS
 	}
    catch(arcusException &e)
@@ -1160,7 +3285,10 @@ static void cc_fn(const iocshArgBuf *args)
 		args[2].ival,
 		args[3].dval,
 		args[4].dval,
-      args[5].ival);
+      args[5].ival,
+      args[6].ival,
+      args[7].ival,
+      args[8].sval);
 }
 
 
@@ -1237,10 +3365,275 @@ static void ca_fn(const iocshArgBuf *args)
 	arcusCreateAxis(args[0].sval, args[1].ival, args[2].ival);
 }
 
+/* arcusSetRetryPolicy called to change how hard a controller retries a      */
+/* failed command before declaring its link down.                             */
+static const iocshArg rp_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg rp_a1 = {"Retries [int]",                    iocshArgInt};
+static const iocshArg rp_a2 = {"Min backoff (s) [double]",         iocshArgDouble};
+static const iocshArg rp_a3 = {"Max backoff (s) [double]",         iocshArgDouble};
+
+static const iocshArg * const rp_as[] = {&rp_a0, &rp_a1, &rp_a2, &rp_a3};
+
+static const iocshFuncDef rp_def = {"arcusSetRetryPolicy", 4, rp_as};
+
+extern "C" int arcusSetRetryPolicy(
+	const char *controllerPortName,
+	int        retries,
+	double     backoffMin,
+	double     backoffMax)
+{
+   arcusController *pC;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusSetRetryPolicy: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   if(pC->setRetryPolicy(retries, backoffMin, backoffMax) != asynSuccess)
+   {
+		printf("arcusSetRetryPolicy: Error invalid policy (%d, %g, %g)\n",
+         retries, backoffMin, backoffMax);
+		return(asynError);
+   }
+   return(asynSuccess);
+}
+
+static void rp_fn(const iocshArgBuf *args)
+{
+	arcusSetRetryPolicy(args[0].sval, args[1].ival, args[2].dval, args[3].dval);
+}
+
+/* arcusSetPipelining called to turn pipelined command sequences on or off.  */
+static const iocshArg pl_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg pl_a1 = {"Enable [int]",                     iocshArgInt};
+
+static const iocshArg * const pl_as[] = {&pl_a0, &pl_a1};
+
+static const iocshFuncDef pl_def = {"arcusSetPipelining", 2, pl_as};
+
+extern "C" int arcusSetPipelining(
+	const char *controllerPortName,
+	int        enable)
+{
+   arcusController *pC;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusSetPipelining: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   return(pC->setPipelining(enable));
+}
+
+static void pl_fn(const iocshArgBuf *args)
+{
+	arcusSetPipelining(args[0].sval, args[1].ival);
+}
+
+/* arcusSetBusSchedule called to set how many idle DMX-K-SA drives on a      */
+/* shared bus are polled per cycle while other axes are moving.              */
+static const iocshArg bs_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg bs_a1 = {"Idle axes per cycle [int]",        iocshArgInt};
+
+static const iocshArg * const bs_as[] = {&bs_a0, &bs_a1};
+
+static const iocshFuncDef bs_def = {"arcusSetBusSchedule", 2, bs_as};
+
+extern "C" int arcusSetBusSchedule(
+	const char *controllerPortName,
+	int        idleAxesPerCycle)
+{
+   arcusController *pC;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusSetBusSchedule: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   if(pC->setBusSchedule(idleAxesPerCycle) != asynSuccess)
+   {
+		printf("arcusSetBusSchedule: Error invalid count %d\n",
+         idleAxesPerCycle);
+		return(asynError);
+   }
+   return(asynSuccess);
+}
+
+static void bs_fn(const iocshArgBuf *args)
+{
+	arcusSetBusSchedule(args[0].sval, args[1].ival);
+}
+
+/* arcusSetPollGuard called to set how long before a move's predicted end    */
+/* the poller goes back to the moving poll period; negative turns predicted  */
+/* polling off.                                                              */
+static const iocshArg pg_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg pg_a1 = {"Guard time (s) [double]",          iocshArgDouble};
+
+static const iocshArg * const pg_as[] = {&pg_a0, &pg_a1};
+
+static const iocshFuncDef pg_def = {"arcusSetPollGuard", 2, pg_as};
+
+extern "C" int arcusSetPollGuard(
+	const char *controllerPortName,
+	double     guard)
+{
+   arcusController *pC;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusSetPollGuard: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   return(pC->setPollGuard(guard));
+}
+
+static void pg_fn(const iocshArgBuf *args)
+{
+	arcusSetPollGuard(args[0].sval, args[1].dval);
+}
+
+/* arcusSetTraceLevel called to choose which driver trace messages are       */
+/* formatted: 0 none, 1 axis operations, 2 also every poll.                  */
+static const iocshArg tl_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg tl_a1 = {"Trace level [int]",                iocshArgInt};
+
+static const iocshArg * const tl_as[] = {&tl_a0, &tl_a1};
+
+static const iocshFuncDef tl_def = {"arcusSetTraceLevel", 2, tl_as};
+
+extern "C" int arcusSetTraceLevel(
+	const char *controllerPortName,
+	int        level)
+{
+   arcusController *pC;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusSetTraceLevel: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   return(pC->setTraceLevel(level));
+}
+
+static void tl_fn(const iocshArgBuf *args)
+{
+	arcusSetTraceLevel(args[0].sval, args[1].ival);
+}
+
+/* arcusSetPositionDeadband called to hold back position and encoder updates */
+/* smaller than this many steps; 0 publishes every change.                   */
+static const iocshArg db_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg db_a1 = {"Deadband (steps) [int]",           iocshArgInt};
+
+static const iocshArg * const db_as[] = {&db_a0, &db_a1};
+
+static const iocshFuncDef db_def = {"arcusSetPositionDeadband", 2, db_as};
+
+extern "C" int arcusSetPositionDeadband(
+	const char *controllerPortName,
+	int        deadband)
+{
+   arcusController *pC;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusSetPositionDeadband: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   return(pC->setPositionDeadband(deadband));
+}
+
+static void db_fn(const iocshArgBuf *args)
+{
+	arcusSetPositionDeadband(args[0].sval, args[1].ival);
+}
+
+/* arcusCreateProfile called to allow profile moves of up to maxPoints       */
+/* points on a controller.                                                    */
+static const iocshArg cp_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg cp_a1 = {"Max points [int]",                 iocshArgInt};
+
+static const iocshArg * const cp_as[] = {&cp_a0, &cp_a1};
+
+static const iocshFuncDef cp_def = {"arcusCreateProfile", 2, cp_as};
+
+extern "C" int arcusCreateProfile(
+	const char *controllerPortName,
+	int        maxPoints)
+{
+   arcusController *pC;
+   asynStatus      status;
+
+	pC = (arcusController*)findAsynPortDriver(controllerPortName);
+	if(!pC)
+   {
+		printf("arcusCreateProfile: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   if(maxPoints < 2)
+   {
+		printf("arcusCreateProfile: Error need at least 2 points\n");
+		return(asynError);
+   }
+   pC->lock();
+   status = pC->initializeProfile(maxPoints);
+   pC->unlock();
+   return(status);
+}
+
+static void cp_fn(const iocshArgBuf *args)
+{
+	arcusCreateProfile(args[0].sval, args[1].ival);
+}
+
+/* arcusSetDeferredInit called before arcusCreateController to have the      */
+/* controllers created after it probed on threads of their own, concurrently, */
+/* finishing before iocInit gets to the device support.                       */
+static const iocshArg di_a0 = {"Enable [int]",                     iocshArgInt};
+
+static const iocshArg * const di_as[] = {&di_a0};
+
+static const iocshFuncDef di_def = {"arcusSetDeferredInit", 1, di_as};
+
+extern "C" int arcusSetDeferredInit(int enable)
+{
+   if(enable)
+      arcusHookDeferredInit();
+   arcusDeferInit = (enable != 0);
+   return(asynSuccess);
+}
+
+static void di_fn(const iocshArgBuf *args)
+{
+	arcusSetDeferredInit(args[0].ival);
+}
+
 static void arcusMotorRegister(void)
 {
   iocshRegister(&cc_def, cc_fn);  // arcusCreateController
   iocshRegister(&ca_def, ca_fn);  // arcusCreateAxis
+  iocshRegister(&rp_def, rp_fn);  // arcusSetRetryPolicy
+  iocshRegister(&pl_def, pl_fn);  // arcusSetPipelining
+  iocshRegister(&bs_def, bs_fn);  // arcusSetBusSchedule
+  iocshRegister(&pg_def, pg_fn);  // arcusSetPollGuard
+  iocshRegister(&tl_def, tl_fn);  // arcusSetTraceLevel
+  iocshRegister(&db_def, db_fn);  // arcusSetPositionDeadband
+  iocshRegister(&cp_def, cp_fn);  // arcusCreateProfile
+  iocshRegister(&di_def, di_fn);  // arcusSetDeferredInit
 }
 
 extern "C"
@@ -20,9 +20,136 @@
 
 #include <asynMotorController.h>
 #include <asynMotorAxis.h>
+#include <epicsTime.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
 #include <stdarg.h>
 #include <exception>
 
+/* Size of the controller's receive buffer used for reply framing.            */
+#define ARCUS_RX_LEN 256
+
+/* Number of speed registers (HSPD, LSPD, ACC) shadowed per axis.             */
+#define SPEED_REGS 3
+
+/* Longest fixed part of an axis command, numeric tail not included.          */
+#define CMD_TMPL_LEN 12
+
+/* Commands an axis sends. The text for each is built once per axis from the  */
+/* dialect table in arcusMotorDriver.cpp; the ones marked with a value take   */
+/* a number appended to the template, see arcusAxis::axisCmd().               */
+enum arcusAxisCmd_t {
+   CMD_MST,          /* Motor status.                                         */
+   CMD_ENC,          /* Encoder position.                                     */
+   CMD_POS,          /* Pulse (commanded) position.                           */
+   CMD_ABS,          /* Absolute move mode.                                   */
+   CMD_INC,          /* Incremental move mode.                                */
+   CMD_EO,           /* Enable the drive outputs.                             */
+   CMD_MOVE,         /* Move to, value.                                       */
+   CMD_HOME_POS,     /* Home in the positive direction.                       */
+   CMD_HOME_NEG,     /* Home in the negative direction.                       */
+   CMD_JOG_POS,      /* Jog in the positive direction.                        */
+   CMD_JOG_NEG,      /* Jog in the negative direction.                        */
+   CMD_STOP,         /* Decelerate to a stop.                                 */
+   CMD_HSPD,         /* High speed, value. CMD_HSPD..CMD_ACC are in the same  */
+   CMD_LSPD,         /* Low speed, value.  order as shadowSpeed_[].           */
+   CMD_ACC,          /* Acceleration (ms), value.                             */
+   CMD_SET_POS,      /* Redefine the position register, value.                */
+   CMD_SSPD,         /* Change the speed of a move on the fly, value.         */
+   CMD_LATCH_ON,     /* Arm the latch input.                                  */
+   CMD_LATCH_OFF,    /* Disarm the latch input.                               */
+   CMD_LATCH_STAT,   /* Latch status: 0 off, 1 armed, 2 triggered.            */
+   CMD_LATCH_ENC,    /* Latched encoder position.                             */
+   CMD_LATCH_POS,    /* Latched pulse position.                               */
+   NUM_AXIS_CMDS
+};
+
+/* Command classes the controller keeps statistics for, see noteCmd().        */
+enum arcusCmdClass_t {
+   CLASS_STATUS, CLASS_ENCODER, CLASS_POSITION, CLASS_SPEED, CLASS_MOTION,
+   CLASS_STOP, CLASS_OTHER, NUM_CMD_CLASSES
+};
+
+/* Reply latency histogram buckets, see arcusLatencyEdges[].                  */
+#define NUM_LATENCY_BUCKETS 12
+
+/* Counted without taking the controller lock (epicsAtomic).                  */
+struct arcusCmdStats {
+   size_t count;
+   size_t errors;
+   size_t hist[NUM_LATENCY_BUCKETS];
+};
+
+/* I/O queue priorities: stop, other commands, status queries.               */
+#define NUM_IO_PRIO 3
+
+/* A sendCmd() or sendCmds() call waiting for the controller's I/O thread.    */
+struct arcusIoRequest {
+   arcusIoRequest     *next;
+   int                nCmds;      /* 0 for a single sendCmd().               */
+   size_t             *got_p;     /* sendCmd() arguments.                    */
+   char               *rep;
+   int                len;
+   double             timeout;
+   const char         *cmd;
+   int                cmdLen;
+   const char * const *cmds;      /* sendCmds() arguments.                   */
+   asynStatus         *cmdStatus;
+   arcusCmdClass_t    cls;
+   bool               once;       /* One pass, link state left alone.        */
+   asynStatus         status;
+   epicsEventId       done;
+};
+
+/* Status query replies kept for the proxy, see arcusController::cachedReply */
+#define REPLY_CACHE_LEN 64
+
+struct arcusCachedReply {
+   char           cmd[CMD_TMPL_LEN];
+   char           rep[ARCUS_RX_LEN];
+   size_t         got;
+   epicsTimeStamp time;
+};
+
+struct arcusCmdTemplate {
+   char   str[CMD_TMPL_LEN];
+   size_t len;
+};
+
+/* Number of latch captures kept per axis.                                    */
+#define LATCH_RING_LEN 256
+
+/* Number of poll samples kept per axis.                                      */
+#define SAMPLE_RING_LEN 1024
+
+struct arcusSample {
+   epicsTimeStamp time;
+   epicsInt32     encoder;
+   epicsInt32     position;
+   epicsInt32     status;
+};
+
+/* The last size() samples pushed, older ones overwritten.                    */
+class arcusRing {
+public:
+   arcusRing() : buf_(0), size_(0), next_(0), total_(0) {}
+   ~arcusRing() { delete [] buf_; }
+   void   init(size_t size);
+   void   push(const arcusSample &sample);
+   size_t size() const { return size_; }
+   size_t count() const { return (total_ < size_) ? total_ : size_; }
+   size_t total() const { return total_; }
+   /* Sample i of count(), oldest first.                                     */
+   const arcusSample &at(size_t i) const
+      { return buf_[(next_ + size_ - count() + i) % size_]; }
+private:
+   arcusSample *buf_;
+   size_t      size_;
+   size_t      next_;
+   size_t      total_;
+};
+
 enum arcusExceptionType {
 	MCSUnknownError,
 	MCSConnectionError,
@@ -49,10 +176,29 @@ protected:
 };
 
 
+double arcusMoveTime(double dist, double vmin, double vmax, double accel);
+
+/* Outcome of arcusParseInts(), see arcusParseStatusStrings[].                */
+enum arcusParseStatus_t {
+   PARSE_OK,
+   PARSE_EMPTY,         /* Nothing but white space.                           */
+   PARSE_REJECTED,      /* The controller answered '?', command not accepted. */
+   PARSE_NOT_NUMBER,    /* A field holds no digits.                           */
+   PARSE_RANGE,         /* A field does not fit in an int.                    */
+   PARSE_TOO_FEW,       /* Reply ends before the last field.                  */
+   PARSE_BAD_SEPARATOR, /* Something other than ':' between fields.           */
+   PARSE_TRAILING       /* Junk after the last field.                         */
+};
+extern const char *arcusParseStatusStrings[];
+
+arcusParseStatus_t arcusParseInts(const char *rep, size_t len, int *vals,
+                                  int nVals);
+
 class arcusAxis : public asynMotorAxis
 {
 public:
 	arcusAxis(class arcusController *cnt_p, int axis, int channel);
+   void        probe();
 	asynStatus  poll(bool *moving_p);
 	asynStatus  move(double position, int relative, double min_vel, double max_vel, double accel);
 	asynStatus  home(double min_vel, double max_vel, double accel, int forwards);
@@ -67,8 +213,19 @@ public:
    asynStatus getAxisStatus(int axis, int *val);
    asynStatus getEncoderVal(int axis, int *val);
    asynStatus getPositionVal(int axis, int *val);
+   asynStatus getAxisVal(arcusAxisCmd_t cmd, int axis, int *val);
+   size_t     axisCmd(char *buf, arcusAxisCmd_t cmd, long val) const;
 
 protected:
+   void       publish(int enc, int pos, int flags);
+   void       predictMove(double dist, double min_vel, double max_vel,
+                          double accel);
+   asynStatus pollError();
+   bool       profileNewRun(int i) const;
+   asynStatus profileSegment(int i, double accel);
+   asynStatus armLatch(int mode);
+   void       pollLatch(int mst);
+   void       publishLatch();
 	asynStatus setSpeed(double velocity);
    asynStatus setSpeed(double velocity, double lowSpeed, double accel);
 
@@ -79,7 +236,56 @@ private:
 	unsigned    holdTime_;
    int         axis_;
 	char        channel_;
+   int         channelNo_;
    char        Arcus_Com_Prefix[4];
+   arcusCmdTemplate cmdTable_[NUM_AXIS_CMDS]; /* See buildCmdTable().        */
+   void        buildCmdTable();
+   /* Values handed out by arcusController::poll() for controllers that      */
+   /* report every axis in a single reply (PMX-4ET-SA).                      */
+   bool        polled_;
+   asynStatus  polledComStatus_;
+   int         polledEncoder_;
+   int         polledPosition_;
+   int         polledStatus_;
+   unsigned    polledSeq_;        /* startSeq_ when they were read.           */
+   /* How the next poll() should query the drive, set by the bus scheduler.  */
+   enum PollMode_t {POLL_FULL, POLL_REDUCED, POLL_SKIP};
+   PollMode_t  pollMode_;
+   bool        moving_;           /* Moving as of the last poll or command.   */
+   unsigned    startSeq_;         /* Bumped by every move started.            */
+   int         jogDir_;           /* Direction of a jog under way, 0 none.    */
+   bool        haveEncoder_;
+   int         lastEncoder_;
+   bool        havePosition_;
+   int         lastPosition_;
+   /* End of the current move as predicted from its profile, if known.      */
+   bool        predicted_;
+   double      moveTime_;
+   epicsTimeStamp predictedEnd_;
+   /* What poll() last handed to the motor record, see publish().           */
+   bool        published_;
+   bool        pubMoving_;
+   bool        pubError_;
+   int         pubEncoder_;
+   int         pubPosition_;
+   int         pubStatus_;        /* Decoded status flags.                   */
+   /* Move queued while the controller defers moves.                        */
+   bool        deferred_;
+   double      deferTarget_;      /* Absolute.                               */
+   double      deferMin_;
+   double      deferMax_;
+   double      deferAccel_;
+   /* Profile move state, see arcusController::runProfile().                */
+   bool        inProfile_;
+   int         profileDir_;       /* Direction of the current run, 0 none.   */
+   /* Latch input, see pollLatch().                                         */
+   int         latchMode_;        /* 0 off, 1 one capture, 2 re-arm.          */
+   arcusRing   latch_;
+   arcusRing   samples_;          /* What each poll read.                     */
+   /* Speed register values last acknowledged by the controller.             */
+   long        shadowSpeed_[SPEED_REGS];
+   int         shadowValid_;      /* Bit i set when shadowSpeed_[i] is good.  */
+   unsigned    shadowGeneration_; /* linkGeneration_ the shadow belongs to.   */
 
 friend class arcusController;
 };
@@ -93,27 +299,180 @@ class arcusController : public asynMotorController
 {
 public:
 	arcusController(const char *portName, const char *IOPortName, int numAxes,
-       double movingPollPeriod, double idlePollPeriod, int ArcusControllerFlag);
+       double movingPollPeriod, double idlePollPeriod, int ArcusControllerFlag,
+       int maxBaud, int storeBaud, const char *modelHint = 0);
 	virtual asynStatus sendCmd(size_t *got_p, char *rep, int len, double timeout,
-           const char *cmd, int cmdLen);
+           const char *cmd, int cmdLen, arcusCmdClass_t cls = CLASS_OTHER);
+   asynStatus sendCmdOnce(size_t *got_p, char *rep, int len, double timeout,
+           const char *cmd, int cmdLen, arcusCmdClass_t cls);
+   asynStatus sendCmds(int nCmds, const char * const *cmds,
+           asynStatus *cmdStatus, arcusCmdClass_t cls = CLASS_MOTION);
+   virtual asynStatus poll();
+   virtual asynStatus setDeferredMoves(bool defer);
+   virtual asynStatus initializeProfile(size_t maxPoints);
+   virtual asynStatus buildProfile();
+   virtual asynStatus executeProfile();
+   virtual asynStatus abortProfile();
+   virtual asynStatus readbackProfile();
+   void       profileThread();
+   void       initThread();
+   void       ioThread();
+   static void finishDeferredInit();
+   virtual void report(FILE *fp, int level);
+   virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+   virtual asynStatus readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+           size_t nElements, size_t *nIn);
+   virtual asynStatus readFloat64Array(asynUser *pasynUser,
+           epicsFloat64 *value, size_t nElements, size_t *nIn);
+   asynStatus getAllAxesVal(const char *cmd, int *vals, arcusCmdClass_t cls);
+   asynStatus setRetryPolicy(int retries, double backoffMin, double backoffMax);
+   asynStatus setPipelining(int enable);
+   asynStatus setBusSchedule(int idleAxesPerCycle);
+   asynStatus setPollGuard(double guard);
+   asynStatus setTraceLevel(int level);
+   asynStatus setPositionDeadband(int deadband);
+   void       getTraffic(unsigned long *cmds, unsigned long *roundTrips) const;
+   epicsThreadId pollerThread() const;
+   void       setPollerThread(epicsThreadId id);
+   bool       ioReady() const;
+   void       forgetAxisState();
+   asynStatus setReplyCache(double maxAge);
+   bool       cachedReply(const char *cmd, int cmdLen, char *rep, int len,
+                          size_t *got_p);
 	
 	static int parseReply(const char *reply, int *ax_p, int *val_p);
 
    enum ControllerType_t {UNKNOWN, DMX_ETH, PMX_4ET_SA, DMX_K_SA};
    static const char *ControllerTypeStrings[];
+   static const char *ModelHintStrings[];
    ControllerType_t ArcusModel;
 
+   /* Health of the link to the controller. A command that exhausts its      */
+   /* retries marks the link DOWN; further commands then fail immediately    */
+   /* until the reconnect hold-off expires, at which point one command is    */
+   /* let through to probe the link.                                         */
+   enum LinkState_t {LINK_UP, LINK_SUSPECT, LINK_DOWN};
+   static const char *LinkStateStrings[];
+
+   /* Driver trace levels, see arcusSetTraceLevel.                           */
+   enum TraceLevel_t {ARCUS_TRACE_NONE, ARCUS_TRACE_CMD, ARCUS_TRACE_POLL};
+
 protected:
 	arcusAxis **pAxes_;
 
+   /* Statistics parameters, created in order starting at arcusCmdCount_.    */
+   int arcusCmdCount_[NUM_CMD_CLASSES];
+#define FIRST_ARCUS_PARAM arcusCmdCount_[0]
+   int arcusCmdErrors_[NUM_CMD_CLASSES];
+   int arcusCmdLatency_[NUM_CMD_CLASSES];
+   int arcusRetries_;
+   int arcusReconnects_;
+   int arcusTimeouts_;
+   /* Per axis latch parameters, see arcusAxis::pollLatch().                */
+   int arcusLatchArm_;
+   int arcusLatchCount_;
+   int arcusLatchEncoder_;
+   int arcusLatchPosition_;
+   int arcusLatchTime_;
+   /* Per axis poll history.                                                */
+   int arcusSampleEncoder_;
+   int arcusSamplePosition_;
+   int arcusSampleStatus_;
+   int arcusSampleTime_;
+#define LAST_ARCUS_PARAM arcusSampleTime_
+#define NUM_ARCUS_PARAMS ((int)(&LAST_ARCUS_PARAM - &FIRST_ARCUS_PARAM + 1))
+
 private:
+   asynStatus writeReadOnce(size_t *got_p, char *rep, int len, double timeout,
+           const char *cmd, int cmdLen);
+   asynStatus readFrame(size_t *got_p, char *rep, int len, double timeout);
+   bool       isReplyTerminator(char c) const;
+   bool       frameOnGap() const;
+   void       linkDown();
+   void       scheduleBus();
+   void       schedulePoll();
+   void       noteCmd(arcusCmdClass_t cls, asynStatus status,
+                      const epicsTimeStamp *start);
+   void       publishStats();
+   asynStatus flushDeferredMoves();
+   int        runProfile(char *msg);
+   int        waitProfileAxes(arcusAxis *pOnly, double timeout, char *msg);
+   asynStatus readProfilePoint(int i);
+   void       probe();
+   asynStatus sendCmdNow(size_t *got_p, char *rep, int len, double timeout,
+           const char *cmd, int cmdLen, arcusCmdClass_t cls,
+           bool once = false);
+   asynStatus sendCmdsNow(int nCmds, const char * const *cmds,
+           asynStatus *cmdStatus, arcusCmdClass_t cls);
+   asynStatus submit(arcusIoRequest *req);
+   void       cacheReply(const char *cmd, int cmdLen, const char *rep,
+                         size_t got);
+   void       startIoThread();
+   size_t     identify(char *rbuf, int len);
+   size_t     flushInput();
+   size_t     probeBaud(char *rbuf, int len);
+   bool       firstOnDrive(int axis) const;
+   asynStatus negotiateBaud(int maxBaud, bool store);
+   asynStatus setPortBaud(int baud);
+   asynStatus getPortBaud(int *baud);
+
 	asynUser *asynUserMot_p_;
 	asynUser *asynUserCommonMot_p_;
+   asynUser *asynUserOption_p_;
+   LinkState_t    linkState_;
+   int            retries_;     /* Extra attempts after a failed command.    */
+   double         backoffMin_;  /* First delay between attempts (s).         */
+   double         backoffMax_;  /* Upper bound for delays and hold-off (s).  */
+   double         holdOff_;     /* Current reconnect hold-off (s).           */
+   epicsTimeStamp nextReconnect_;
+   char           rxBuf_[ARCUS_RX_LEN]; /* Bytes received, not yet framed.   */
+   size_t         rxLen_;
+   unsigned       linkGeneration_; /* Bumped each time the link is remade.   */
+   bool           pipeline_;       /* Pipeline sendCmds() over Ethernet.     */
+   bool           eosSeen_;        /* A reply came with its terminator.      */
+   int            idleAxesPerCycle_; /* See scheduleBus().                   */
+   int            nextIdleAxis_;
+   double         densePollPeriod_; /* Moving poll period from st.cmd.       */
+   double         pollGuard_;      /* See schedulePoll().                    */
+   unsigned long  txCmds_;         /* See getTraffic().                      */
+   unsigned long  txRoundTrips_;
+   arcusCmdStats  cmdStats_[NUM_CMD_CLASSES];
+   size_t         retryCount_;
+   size_t         reconnectCount_;
+   size_t         timeoutCount_;
+   epicsInt32     latencySnap_[NUM_CMD_CLASSES][NUM_LATENCY_BUCKETS];
+   epicsTimeStamp statsPublished_;
+   int            traceLevel_;     /* See ARCUS_TRACE.                       */
+   int            positionDeadband_; /* Steps, see arcusAxis::publish().     */
+   bool           deferMoves_;     /* See setDeferredMoves().                */
+   bool           rs485First_;     /* Try @01ID before ID, see identify().   */
+   /* Start-up arguments, kept for probe() and deferred initialisation.     */
+   double         idlePeriod_;
+   int            maxBaud_;
+   int            storeBaud_;
+   char           modelHint_[24];
+   bool           initPending_;    /* Axes not probed yet, see initThread(). */
+   epicsEventId   axesReady_;
+   epicsEventId   initDone_;
+   arcusController *nextDeferred_;
+   /* I/O queue, see submit().                                              */
+   epicsMutexId   ioLock_;
+   epicsEventId   ioWake_;         /* Something was queued.                  */
+   epicsEventId   urgentWake_;     /* Something other than a query was.      */
+   arcusIoRequest *ioHead_[NUM_IO_PRIO];
+   arcusIoRequest *ioTail_[NUM_IO_PRIO];
+   int            urgentQueued_;
+   epicsThreadId  ioThreadId_;
+   epicsThreadId  pollerId_;       /* Thread in poll(), which yields.        */
+   /* Status query replies, see cachedReply(); none until a proxy asks.     */
+   epicsMutexId   cacheLock_;
+   arcusCachedReply *cache_;
+   double         cacheAge_;       /* Oldest reply handed out (s).           */
+   epicsEventId   profileEvent_;   /* Wakes the profile thread.              */
+   bool           profileAborted_;
+   int            profileNumRead_; /* Points read back by the last run.      */
 friend class arcusAxis;
 };
 
-const char *arcusController::ControllerTypeStrings[] = {"UNKNOWN",
-   "DMX-SERIES-ETH", "Performax-4ET-SA", "DriveMax-K-SA"};
-   
 #endif // _cplusplus
 #endif // ARCUS_MOTOR_DRIVER_H
@@ -0,0 +1,246 @@
+/* ex: set shiftwidth=3 tabstop=3 expandtab: */
+
+/*************************************************************************\
+* Copyright (c) 2015, Triad National Security, LLC.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* Local proxy for an Arcus controller, run from the IOC shell.              */
+/*                                                                            */
+/* The controllers' ASCII interface serves one client at a time. The proxy   */
+/* lets engineering tools share the IOC's connection instead of fighting it  */
+/* for the socket: it listens on a local TCP port and passes each command a  */
+/* client sends to arcusController::sendCmdOnce(), where it is queued with   */
+/* the IOC's own traffic (stops first, status queries last). It is written   */
+/* once: a client's command that goes unanswered is neither retried nor      */
+/* taken as a sign that the link is down.                                    */
+/* The reply goes back to the client framed as the controller frames it.     */
+/*                                                                            */
+/* Status queries (MST, PE, PP, EX, PX, with or without an RS-485 prefix)    */
+/* are answered from the controller's reply cache when it holds a reply that */
+/* is young enough, so a diagnostic polling the same axes as the IOC adds no */
+/* traffic on the link. Point a tool, or another asyn IP port, at it:        */
+/*                                                                            */
+/*    arcusProxyStart("P0", 5002, 0.1)                                        */
+/*    drvAsynIPPortConfigure("Diag", "127.0.0.1:5002", 0, 0, 0)               */
+
+#include <iocsh.h>
+
+#include <asynMotorController.h>
+#include <asynMotorAxis.h>
+#include <arcusMotorDriver.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <osiSock.h>
+#include <epicsThread.h>
+#include <epicsExport.h>
+
+#define PROXY_CMD_LEN    64
+#define PROXY_TIMEOUT    1.0     /* Reply timeout per command (s).            */
+#define PROXY_READY_WAIT 0.1     /* Poll for the controller's I/O thread (s). */
+
+struct arcusProxy {
+   arcusController *pC;
+   int             tcpPort;
+};
+
+struct arcusProxyClient {
+   arcusProxy *proxy;
+   SOCKET     sock;
+};
+
+/* Statistics class of a client's command, which also sets its place in the  */
+/* controller's I/O queue. Only exact queries count as such, "PX=0" doesn't. */
+static arcusCmdClass_t arcusProxyClass(const char *cmd)
+{
+   if(*cmd == '@')
+      for(cmd++; isdigit((unsigned char)*cmd); cmd++)
+         ;
+   if(!strncmp(cmd, "STOP", 4))
+      return(CLASS_STOP);
+   if(!strcmp(cmd, "MST"))
+      return(CLASS_STATUS);
+   if(!strcmp(cmd, "PE") || !strcmp(cmd, "EX"))
+      return(CLASS_ENCODER);
+   if(!strcmp(cmd, "PP") || !strcmp(cmd, "PX"))
+      return(CLASS_POSITION);
+   return(CLASS_OTHER);
+}
+
+/* One command from a client. Nothing is sent back when the controller can't */
+/* be reached, just as the controller itself would stay silent. Anything but */
+/* a query may have changed a speed register or started or stopped a motor  */
+/* behind the driver's back, so the driver forgets what it assumed.         */
+static void arcusProxyCommand(arcusProxyClient *client, const char *cmd,
+                              int cmdLen)
+{
+   arcusController *pC = client->proxy->pC;
+   arcusCmdClass_t cls = arcusProxyClass(cmd);
+   char            rep[ARCUS_RX_LEN + 1];
+   size_t          got = 0;
+   asynStatus      status;
+
+   if((cls == CLASS_OTHER) || (cls == CLASS_STOP) ||
+      !pC->cachedReply(cmd, cmdLen, rep, ARCUS_RX_LEN, &got))
+   {
+      status = pC->sendCmdOnce(&got, rep, ARCUS_RX_LEN, PROXY_TIMEOUT, cmd,
+                               cmdLen, cls);
+      if((cls == CLASS_OTHER) || (cls == CLASS_STOP))
+         pC->forgetAxisState();
+      if(status != asynSuccess)
+         return;
+   }
+   if(got > ARCUS_RX_LEN)
+      got = ARCUS_RX_LEN;
+   rep[got++] = (pC->ArcusModel == arcusController::DMX_K_SA) ? '\r' : '\0';
+   send(client->sock, rep, (int)got, 0);
+}
+
+/* Serve one client. Commands end with NUL, CR or LF, as for the controller. */
+static void arcusProxyClientThread(void *arg)
+{
+   arcusProxyClient *client = (arcusProxyClient *)arg;
+   char             rx[PROXY_CMD_LEN * 4];
+   char             cmd[PROXY_CMD_LEN];
+   int              cmdLen = 0;
+   int              got, i;
+
+   while((got = recv(client->sock, rx, sizeof(rx), 0)) > 0)
+   {
+      for(i = 0; i < got; i++)
+      {
+         if((rx[i] != '\0') && (rx[i] != '\r') && (rx[i] != '\n'))
+         {
+            if(cmdLen < (int)sizeof(cmd) - 1)
+               cmd[cmdLen++] = (char)toupper((unsigned char)rx[i]);
+            continue;
+         }
+         if(cmdLen == 0)
+            continue;
+         cmd[cmdLen] = 0;
+         arcusProxyCommand(client, cmd, cmdLen);
+         cmdLen = 0;
+      }
+   }
+   epicsSocketDestroy(client->sock);
+   free(client);
+}
+
+/* Wait for the controller to come up, then take clients for ever.          */
+static void arcusProxyThread(void *arg)
+{
+   arcusProxy       *proxy = (arcusProxy *)arg;
+   arcusProxyClient *client;
+   osiSockAddr      addr;
+   osiSocklen_t     addrLen;
+   SOCKET           listenSock, sock;
+
+   while(!proxy->pC->ioReady())
+      epicsThreadSleep(PROXY_READY_WAIT);
+
+   listenSock = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+   if(listenSock == INVALID_SOCKET)
+   {
+      printf("arcusProxyStart: can't create socket\n");
+      return;
+   }
+   epicsSocketEnableAddressReuseDuringTimeWaitState(listenSock);
+   memset(&addr, 0, sizeof(addr));
+   addr.ia.sin_family      = AF_INET;
+   addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.ia.sin_port        = htons((unsigned short)proxy->tcpPort);
+   if((bind(listenSock, &addr.sa, sizeof(addr.ia)) != 0) ||
+      (listen(listenSock, 5) != 0))
+   {
+      printf("arcusProxyStart: can't listen on port %d\n", proxy->tcpPort);
+      epicsSocketDestroy(listenSock);
+      return;
+   }
+
+   for(;;)
+   {
+      addrLen = sizeof(addr);
+      sock = epicsSocketAccept(listenSock, &addr.sa, &addrLen);
+      if(sock == INVALID_SOCKET)
+         continue;
+      if(!(client = (arcusProxyClient *)malloc(sizeof(arcusProxyClient))))
+      {
+         epicsSocketDestroy(sock);
+         continue;
+      }
+      client->proxy = proxy;
+      client->sock  = sock;
+      epicsThreadCreate("arcusProxyClient", epicsThreadPriorityMedium,
+         epicsThreadGetStackSize(epicsThreadStackMedium),
+         arcusProxyClientThread, client);
+   }
+}
+
+/* arcusProxyStart(port, tcpPort, cacheAge)                                   */
+extern "C" int arcusProxyStart(const char *controllerPortName, int tcpPort,
+   double cacheAge)
+{
+   arcusController *pC;
+   arcusProxy      *proxy;
+
+   pC = (arcusController*)findAsynPortDriver(controllerPortName);
+   if(!pC)
+   {
+		printf("arcusProxyStart: Error port %s not found\n",
+         controllerPortName);
+		return(asynError);
+	}
+   if((tcpPort <= 0) || (tcpPort > 65535))
+   {
+      printf("arcusProxyStart: bad TCP port %d\n", tcpPort);
+      return(asynError);
+   }
+   if(!osiSockAttach())
+   {
+      printf("arcusProxyStart: no sockets\n");
+      return(asynError);
+   }
+   if((cacheAge > 0.0) && (pC->setReplyCache(cacheAge) != asynSuccess))
+   {
+      printf("arcusProxyStart: out of memory\n");
+      return(asynError);
+   }
+   if(!(proxy = (arcusProxy *)calloc(1, sizeof(arcusProxy))))
+   {
+      printf("arcusProxyStart: out of memory\n");
+      return(asynError);
+   }
+   proxy->pC      = pC;
+   proxy->tcpPort = tcpPort;
+   epicsThreadCreate("arcusProxy", epicsThreadPriorityMedium,
+      epicsThreadGetStackSize(epicsThreadStackSmall), arcusProxyThread, proxy);
+   return(asynSuccess);
+}
+
+static const iocshArg px_a0 = {"Controller Port name [string]",    iocshArgString};
+static const iocshArg px_a1 = {"TCP port [int]",                   iocshArgInt};
+static const iocshArg px_a2 = {"Cache age (s) [double]",           iocshArgDouble};
+
+static const iocshArg * const px_as[] = {&px_a0, &px_a1, &px_a2};
+
+static const iocshFuncDef px_def = {"arcusProxyStart", 3, px_as};
+
+static void px_fn(const iocshArgBuf *args)
+{
+	arcusProxyStart(args[0].sval, args[1].ival, args[2].dval);
+}
+
+static void arcusProxyRegister(void)
+{
+  iocshRegister(&px_def, px_fn);  // arcusProxyStart
+}
+
+extern "C"
+{
+   epicsExportRegistrar(arcusProxyRegister);
+}
@@ -0,0 +1,782 @@
+/* ex: set shiftwidth=3 tabstop=3 expandtab: */
+
+/*************************************************************************\
+* Copyright (c) 2015, Triad National Security, LLC.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* Arcus controller simulator.                                                */
+/*                                                                            */
+/* Listens on a TCP port and answers the ASCII commands arcusMotorDriver.cpp  */
+/* sends, in the dialect of a PMX-4ET-SA, a DMX-ETH or a line of DMX-K-SA     */
+/* drives, so the driver can be run and timed without hardware. Point an asyn */
+/* IP port at it:                                                             */
+/*                                                                            */
+/*    drvAsynIPPortConfigure("Ether", "127.0.0.1:5001", 0, 0, 0)              */
+/*                                                                            */
+/* Moves follow the controller's trapezoidal profile (start at LSPD, ramp to  */
+/* HSPD in ACC ms, ramp back down), integrated in 1 ms steps whenever the     */
+/* simulator is asked anything. Reply latency, jitter and a handful of faults */
+/* can be injected; run 'arcusSim -h' for the options. SSPD changes the speed */
+/* of a move or jog on the fly (HSPD follows it), and the latch input can be  */
+/* pulsed periodically to exercise LT, LTS, LTE and LTP.                      */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <osiSock.h>
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#define SIM_MAX_AXES   32
+#define SIM_CMD_LEN    64
+#define SIM_REP_LEN    128
+#define SIM_STEP       0.001   /* Motion integration step (s).                */
+
+enum simModel_t {SIM_PMX_4ET_SA, SIM_DMX_ETH, SIM_DMX_K_SA};
+
+/* Motor status bits, as the driver's arcusPMXStatus and arcusDMXStatus.      */
+enum simStatusBit_t {
+   SIM_ACCEL, SIM_DECEL, SIM_CONST, SIM_HOME, SIM_PLUS_LIM, SIM_MINUS_LIM,
+   SIM_PLUS_LIM_ERR, SIM_MINUS_LIM_ERR, NUM_SIM_STATUS_BITS
+};
+static const int simPMXBits[NUM_SIM_STATUS_BITS] = {1, 2, 4, 64, 16, 32,
+                                                    128, 256};
+static const int simDMXBits[NUM_SIM_STATUS_BITS] = {2, 4, 1, 8, 32, 16,
+                                                    128, 64};
+
+enum simMotion_t {SIM_IDLE, SIM_MOVE, SIM_JOG, SIM_HOMING};
+
+typedef struct simAxis {
+   double      pos;        /* Pulse position.                                 */
+   double      encOffset;  /* Encoder minus pulse position.                   */
+   double      v;          /* Current speed (pulses/s).                       */
+   long        hspd;
+   long        lspd;
+   long        acc;        /* ms from LSPD to HSPD.                           */
+   bool        inc;        /* INC rather than ABS mode.                       */
+   bool        enabled;
+   simMotion_t motion;
+   bool        stopping;
+   double      target;
+   int         dir;
+   int         phase;      /* SIM_ACCEL, SIM_DECEL or SIM_CONST.              */
+   int         limitErr;   /* SIM_PLUS_LIM_ERR or SIM_MINUS_LIM_ERR bit, or 0.*/
+   int         latch;      /* LTS: 0 off, 1 armed, 2 triggered.               */
+   long        latchEnc;   /* LTE and LTP, as of the last trigger.            */
+   long        latchPos;
+} simAxis;
+
+typedef struct simConfig {
+   simModel_t  model;
+   int         port;
+   int         nAxes;
+   double      latency;    /* Reply delay (s).                                */
+   double      jitter;     /* Extra random delay, up to this (s).             */
+   double      dropRate;   /* Fraction of replies not sent.                   */
+   double      garbleRate; /* Fraction of replies cut short.                  */
+   double      rejectRate; /* Fraction of commands answered '?'.              */
+   double      closeRate;  /* Fraction of commands after which we hang up.    */
+   bool        noEos;      /* DMX-ETH quirk: replies carry no terminator.     */
+   double      limit;      /* Limit switches at +/- this, 0 for none.         */
+   double      latchPeriod;/* Latch input pulsed every this (s), 0 never.     */
+   unsigned    seed;
+} simConfig;
+
+static simConfig   cfg;
+static simAxis     axes[SIM_MAX_AXES];
+static epicsMutexId simLock;
+static epicsTimeStamp lastUpdate;
+static double      latchClock; /* Time since the last latch pulse (s).         */
+
+static const char *simIdStrings[] = {"Performax-4ET-SA", "DMX-SERIES-ETH",
+                                     "DriveMax-K-SA"};
+
+static double simRandom()
+{
+   return((double)rand() / ((double)RAND_MAX + 1.0));
+}
+
+static void simStop(simAxis *a)
+{
+   a->motion   = SIM_IDLE;
+   a->stopping = false;
+   a->v        = 0.0;
+}
+
+/* Advance one axis by dt seconds.                                            */
+static void simAdvance(simAxis *a, double dt)
+{
+   double accel, h, rem, step, vmin, vmax;
+
+   vmax = (a->hspd > 0) ? (double)a->hspd : 1.0;
+   vmin = (a->lspd < a->hspd) ? (double)a->lspd : vmax;
+   if(vmin < 0.0)
+      vmin = 0.0;
+   accel = (a->acc > 0) ? (vmax - vmin) / (a->acc / 1000.0) : 0.0;
+   if(accel <= 0.0)
+      accel = 1e12;
+
+   while((a->motion != SIM_IDLE) && (dt > 0.0))
+   {
+      h   = (dt < SIM_STEP) ? dt : SIM_STEP;
+      dt -= h;
+      if(a->v < vmin)
+         a->v = vmin;
+      rem = (a->motion == SIM_JOG) ? HUGE_VAL : fabs(a->target - a->pos);
+      if(a->stopping ||
+         ((a->motion != SIM_JOG) &&
+          (rem <= (a->v * a->v - vmin * vmin) / (2.0 * accel))))
+      {
+         a->phase = SIM_DECEL;
+         a->v -= accel * h;
+         if(a->v <= vmin)
+         {
+            a->v = vmin;
+            if(a->stopping)
+            {
+               simStop(a);
+               break;
+            }
+         }
+      }
+      else if(a->v < vmax)
+      {
+         a->phase = SIM_ACCEL;
+         a->v += accel * h;
+         if(a->v > vmax)
+            a->v = vmax;
+      }
+      else if(a->v > vmax)
+      {
+         /* Slowed down on the fly by SSPD.                                  */
+         a->phase = SIM_DECEL;
+         a->v -= accel * h;
+         if(a->v < vmax)
+            a->v = vmax;
+      }
+      else
+         a->phase = SIM_CONST;
+
+      step = a->v * h;
+      if(step >= rem)
+      {
+         a->pos = a->target;
+         simStop(a);
+         break;
+      }
+      a->pos += a->dir * step;
+      if((cfg.limit > 0.0) && (fabs(a->pos) >= cfg.limit))
+      {
+         a->pos = (a->pos > 0.0) ? cfg.limit : -cfg.limit;
+         a->limitErr = (a->pos > 0.0) ? SIM_PLUS_LIM_ERR : SIM_MINUS_LIM_ERR;
+         simStop(a);
+      }
+   }
+}
+
+/* Bring every axis up to the present. Called with simLock held.              */
+static void simUpdate()
+{
+   epicsTimeStamp now;
+   double         dt;
+   int            i;
+
+   epicsTimeGetCurrent(&now);
+   dt = epicsTimeDiffInSeconds(&now, &lastUpdate);
+   lastUpdate = now;
+   for(i = 0; i < cfg.nAxes; i++)
+      simAdvance(&axes[i], dt);
+   if(cfg.latchPeriod <= 0.0)
+      return;
+   latchClock += dt;
+   if(latchClock < cfg.latchPeriod)
+      return;
+   latchClock = fmod(latchClock, cfg.latchPeriod);
+   for(i = 0; i < cfg.nAxes; i++)
+   {
+      if(axes[i].latch != 1)
+         continue;
+      axes[i].latch    = 2;
+      axes[i].latchPos = (long)floor(axes[i].pos + 0.5);
+      axes[i].latchEnc = (long)floor(axes[i].pos + axes[i].encOffset + 0.5);
+   }
+}
+
+static int simStatus(const simAxis *a)
+{
+   const int *bits = (cfg.model == SIM_PMX_4ET_SA) ? simPMXBits : simDMXBits;
+   int       mst = 0;
+
+   if(a->motion != SIM_IDLE)
+      mst |= bits[a->phase];
+   if((a->motion == SIM_IDLE) && (fabs(a->pos) < 0.5))
+      mst |= bits[SIM_HOME];
+   if(cfg.limit > 0.0)
+   {
+      if(a->pos >= cfg.limit)
+         mst |= bits[SIM_PLUS_LIM];
+      if(a->pos <= -cfg.limit)
+         mst |= bits[SIM_MINUS_LIM];
+   }
+   if(a->limitErr)
+      mst |= bits[a->limitErr];
+   return(mst);
+}
+
+static void simStartMove(simAxis *a, double target, simMotion_t motion,
+                         int dir)
+{
+   if(a->motion == SIM_IDLE)
+      a->v = 0.0;
+   a->limitErr = 0;
+   a->stopping = false;
+   a->motion   = motion;
+   a->target   = target;
+   a->dir      = dir;
+   a->phase    = SIM_ACCEL;
+   if(motion == SIM_MOVE)
+   {
+      if(target == a->pos)
+         simStop(a);
+      else
+         a->dir = (target > a->pos) ? 1 : -1;
+   }
+}
+
+/* Home towards the switch at 0, if it lies in the requested direction;       */
+/* otherwise run on like a jog until a limit (if any) stops the axis.         */
+static void simHome(simAxis *a, int dir)
+{
+   if(dir * (0.0 - a->pos) > 0.0)
+      simStartMove(a, 0.0, SIM_HOMING, dir);
+   else
+      simStartMove(a, 0.0, SIM_JOG, dir);
+}
+
+/* If cmd starts with name, return true and leave *val and *hasVal set from   */
+/* an "=<number>" tail; with no tail, cmd must be exactly name.               */
+static bool simMatch(const char *cmd, const char *name, long *val, bool *hasVal)
+{
+   size_t n = strlen(name);
+   char   *end;
+
+   if(strncmp(cmd, name, n) != 0)
+      return(false);
+   cmd += n;
+   *hasVal = false;
+   if(*cmd == 0)
+      return(true);
+   if(*cmd != '=')
+      return(false);
+   *val = strtol(cmd + 1, &end, 10);
+   if((end == cmd + 1) || *end)
+      return(false);
+   *hasVal = true;
+   return(true);
+}
+
+/* Speed and mode registers shared by both dialects: name[ch]=value sets,     */
+/* name[ch] reads back.                                                       */
+static bool simRegister(const char *cmd, const char *name, long *reg,
+                        char *rep)
+{
+   long val;
+   bool hasVal;
+
+   if(!simMatch(cmd, name, &val, &hasVal))
+      return(false);
+   if(hasVal)
+   {
+      *reg = val;
+      strcpy(rep, "OK");
+   }
+   else
+      sprintf(rep, "%ld", *reg);
+   return(true);
+}
+
+/* Latch and on-the-fly speed commands, the same in both dialects but for    */
+/* the PMX-4ET-SA's axis letter after the name (sfx, empty on the DMX).       */
+static bool simAxisExtra(simAxis *a, const char *cmd, const char *sfx,
+                         char *rep)
+{
+   char name[SIM_CMD_LEN];
+   long val;
+   bool hasVal;
+
+   sprintf(name, "SSPD%s", sfx);
+   if(simMatch(cmd, name, &val, &hasVal))
+   {
+      /* Only while a move or jog is under way.                              */
+      if(!hasVal || (val <= 0) ||
+         ((a->motion != SIM_MOVE) && (a->motion != SIM_JOG)) || a->stopping)
+         return(false);
+      a->hspd = val;
+      strcpy(rep, "OK");
+      return(true);
+   }
+   sprintf(name, "LTS%s", sfx);
+   if(!strcmp(cmd, name))
+   {
+      sprintf(rep, "%d", a->latch);
+      return(true);
+   }
+   sprintf(name, "LTE%s", sfx);
+   if(!strcmp(cmd, name))
+   {
+      sprintf(rep, "%ld", a->latchEnc);
+      return(true);
+   }
+   sprintf(name, "LTP%s", sfx);
+   if(!strcmp(cmd, name))
+   {
+      sprintf(rep, "%ld", a->latchPos);
+      return(true);
+   }
+   sprintf(name, "LT%s", sfx);
+   if(simMatch(cmd, name, &val, &hasVal))
+   {
+      if(hasVal)
+      {
+         a->latch = val ? 1 : 0;
+         strcpy(rep, "OK");
+      }
+      else
+         sprintf(rep, "%d", a->latch ? 1 : 0);
+      return(true);
+   }
+   return(false);
+}
+
+static bool simNumber(const char *s, long *val)
+{
+   char *end;
+
+   if(!*s)
+      return(false);
+   *val = strtol(s, &end, 10);
+   return(*end == 0);
+}
+
+/* One PMX-4ET-SA command. Axes are X, Y, Z and U.                            */
+static bool simPMXCommand(const char *cmd, char *rep)
+{
+   static const char *letters = "XYZU";
+   const char *p;
+   char       name[SIM_CMD_LEN];
+   char       sfx[2] = {0, 0};
+   simAxis    *a;
+   long       val;
+   bool       hasVal;
+   int        i;
+
+   if(!strcmp(cmd, "ID"))
+      strcpy(rep, simIdStrings[cfg.model]);
+   else if(!strcmp(cmd, "MST") || !strcmp(cmd, "PE") || !strcmp(cmd, "PP"))
+   {
+      for(i = 0, rep[0] = 0; i < 4; i++)
+      {
+         a = &axes[i];
+         if(cmd[0] == 'M')
+            val = simStatus(a);
+         else
+            val = (long)floor(a->pos + (cmd[1] == 'E' ? a->encOffset : 0.0)
+                              + 0.5);
+         sprintf(rep + strlen(rep), i ? ":%ld" : "%ld", val);
+      }
+   }
+   else if(!strcmp(cmd, "ABS") || !strcmp(cmd, "INC"))
+   {
+      for(i = 0; i < 4; i++)
+         axes[i].inc = (cmd[0] == 'I');
+      strcpy(rep, "OK");
+   }
+   else if(!strcmp(cmd, "STOP"))
+   {
+      for(i = 0; i < 4; i++)
+         if(axes[i].motion != SIM_IDLE)
+            axes[i].stopping = true;
+      strcpy(rep, "OK");
+   }
+   else if(!strncmp(cmd, "EO", 2) && (cmd[2] >= '1') && (cmd[2] <= '4') &&
+           (cmd[3] == '=') && simNumber(cmd + 4, &val))
+   {
+      axes[cmd[2] - '1'].enabled = (val != 0);
+      strcpy(rep, "OK");
+   }
+   else
+   {
+      /* The rest carry the axis letter: <letter><n>, J<letter>+, ...        */
+      if(cmd[0] && (p = strchr(letters, cmd[0])) && simNumber(cmd + 1, &val))
+      {
+         a = &axes[p - letters];
+         simStartMove(a, a->inc ? a->pos + val : (double)val, SIM_MOVE, 1);
+         strcpy(rep, "OK");
+         return(true);
+      }
+      for(i = 0; i < 4; i++)
+      {
+         a = &axes[i];
+         sprintf(name, "STOP%c", letters[i]);
+         if(!strcmp(cmd, name))
+         {
+            if(a->motion != SIM_IDLE)
+               a->stopping = true;
+            strcpy(rep, "OK");
+            return(true);
+         }
+         if(((cmd[0] == 'J') || (cmd[0] == 'H')) && (cmd[1] == letters[i]) &&
+            ((cmd[2] == '+') || (cmd[2] == '-')) && !cmd[3])
+         {
+            if(cmd[0] == 'J')
+               simStartMove(a, 0.0, SIM_JOG, (cmd[2] == '+') ? 1 : -1);
+            else
+               simHome(a, (cmd[2] == '+') ? 1 : -1);
+            strcpy(rep, "OK");
+            return(true);
+         }
+         sprintf(name, "P%c", letters[i]);
+         if(simMatch(cmd, name, &val, &hasVal))
+         {
+            if(hasVal)
+            {
+               a->pos = (double)val;
+               strcpy(rep, "OK");
+            }
+            else
+               sprintf(rep, "%ld", (long)floor(a->pos + 0.5));
+            return(true);
+         }
+         sprintf(name, "HS%c", letters[i]);
+         if(simRegister(cmd, name, &a->hspd, rep))
+            return(true);
+         sprintf(name, "LS%c", letters[i]);
+         if(simRegister(cmd, name, &a->lspd, rep))
+            return(true);
+         sprintf(name, "ACC%c", letters[i]);
+         if(simRegister(cmd, name, &a->acc, rep))
+            return(true);
+         sfx[0] = letters[i];
+         if(simAxisExtra(a, cmd, sfx, rep))
+            return(true);
+      }
+      return(false);
+   }
+   return(true);
+}
+
+/* One DMX command for drive a (prefix already stripped on the DMX-K-SA).     */
+static bool simDMXCommand(simAxis *a, const char *cmd, char *rep)
+{
+   long val;
+   bool hasVal;
+
+   if(!strcmp(cmd, "ID"))
+      strcpy(rep, simIdStrings[cfg.model]);
+   else if(!strcmp(cmd, "MST"))
+      sprintf(rep, "%d", simStatus(a));
+   else if(!strcmp(cmd, "ABS") || !strcmp(cmd, "INC"))
+   {
+      a->inc = (cmd[0] == 'I');
+      strcpy(rep, "OK");
+   }
+   else if(!strcmp(cmd, "STOP"))
+   {
+      if(a->motion != SIM_IDLE)
+         a->stopping = true;
+      strcpy(rep, "OK");
+   }
+   else if(((cmd[0] == 'J') || (cmd[0] == 'H')) &&
+           ((cmd[1] == '+') || (cmd[1] == '-')) && !cmd[2])
+   {
+      if(cmd[0] == 'J')
+         simStartMove(a, 0.0, SIM_JOG, (cmd[1] == '+') ? 1 : -1);
+      else
+         simHome(a, (cmd[1] == '+') ? 1 : -1);
+      strcpy(rep, "OK");
+   }
+   else if((cmd[0] == 'X') && simNumber(cmd + 1, &val))
+   {
+      simStartMove(a, a->inc ? a->pos + val : (double)val, SIM_MOVE, 1);
+      strcpy(rep, "OK");
+   }
+   else if(simMatch(cmd, "PX", &val, &hasVal))
+   {
+      if(hasVal)
+      {
+         a->pos = (double)val;
+         strcpy(rep, "OK");
+      }
+      else
+         sprintf(rep, "%ld", (long)floor(a->pos + 0.5));
+   }
+   else if(simMatch(cmd, "EX", &val, &hasVal))
+   {
+      if(hasVal)
+      {
+         a->encOffset = (double)val - a->pos;
+         strcpy(rep, "OK");
+      }
+      else
+         sprintf(rep, "%ld", (long)floor(a->pos + a->encOffset + 0.5));
+   }
+   else if(simMatch(cmd, "EO", &val, &hasVal))
+   {
+      if(hasVal)
+      {
+         a->enabled = (val != 0);
+         strcpy(rep, "OK");
+      }
+      else
+         sprintf(rep, "%d", a->enabled ? 1 : 0);
+   }
+   else if(simMatch(cmd, "DB", &val, &hasVal) || !strcmp(cmd, "STORE"))
+      strcpy(rep, "OK");
+   else if(!simRegister(cmd, "HSPD", &a->hspd, rep) &&
+           !simRegister(cmd, "LSPD", &a->lspd, rep) &&
+           !simRegister(cmd, "ACC", &a->acc, rep) &&
+           !simAxisExtra(a, cmd, "", rep))
+      return(false);
+   return(true);
+}
+
+/* Answer one command. Returns false if no reply is to be sent at all, which  */
+/* is what happens on an RS-485 line when no drive has the address asked for. */
+static bool simCommand(const char *cmd, char *rep)
+{
+   int  drive;
+   bool ok;
+
+   rep[0] = 0;
+   epicsMutexMustLock(simLock);
+   simUpdate();
+   if(cfg.model == SIM_PMX_4ET_SA)
+      ok = simPMXCommand(cmd, rep);
+   else if(cfg.model == SIM_DMX_ETH)
+      ok = simDMXCommand(&axes[0], cmd, rep);
+   else
+   {
+      if((cmd[0] != '@') || !isdigit((unsigned char)cmd[1]) ||
+         !isdigit((unsigned char)cmd[2]))
+      {
+         epicsMutexUnlock(simLock);
+         return(false);
+      }
+      drive = (cmd[1] - '0') * 10 + (cmd[2] - '0');
+      if((drive < 1) || (drive > cfg.nAxes))
+      {
+         epicsMutexUnlock(simLock);
+         return(false);
+      }
+      ok = simDMXCommand(&axes[drive - 1], cmd + 3, rep);
+   }
+   epicsMutexUnlock(simLock);
+   if(!ok || (simRandom() < cfg.rejectRate))
+      sprintf(rep, "?%s", cmd);
+   return(true);
+}
+
+static void simReply(SOCKET sock, const char *rep)
+{
+   char   buf[SIM_REP_LEN + 2];
+   size_t len = strlen(rep);
+   double delay = cfg.latency + cfg.jitter * simRandom();
+
+   if(delay > 0.0)
+      epicsThreadSleep(delay);
+   if(simRandom() < cfg.dropRate)
+      return;
+   memcpy(buf, rep, len);
+   if(simRandom() < cfg.garbleRate)
+      len /= 2;
+   else if(!cfg.noEos)
+      buf[len++] = (cfg.model == SIM_DMX_K_SA) ? '\r' : '\0';
+   if(len > 0)
+      send(sock, buf, (int)len, 0);
+}
+
+/* Serve one client. Commands end with NUL, CR or LF; several may arrive in   */
+/* one read when the driver pipelines them.                                   */
+static void simClient(void *arg)
+{
+   SOCKET sock = (SOCKET)(size_t)arg;
+   char   rx[SIM_CMD_LEN * 4];
+   char   cmd[SIM_CMD_LEN];
+   char   rep[SIM_REP_LEN];
+   size_t cmdLen = 0;
+   int    got, i;
+   bool   hangUp = false;
+
+   while(!hangUp && ((got = recv(sock, rx, sizeof(rx), 0)) > 0))
+   {
+      for(i = 0; (i < got) && !hangUp; i++)
+      {
+         if((rx[i] != '\0') && (rx[i] != '\r') && (rx[i] != '\n'))
+         {
+            if(cmdLen < sizeof(cmd) - 1)
+               cmd[cmdLen++] = (char)toupper((unsigned char)rx[i]);
+            continue;
+         }
+         if(cmdLen == 0)
+            continue;
+         cmd[cmdLen] = 0;
+         cmdLen = 0;
+         if(simCommand(cmd, rep))
+            simReply(sock, rep);
+         hangUp = (simRandom() < cfg.closeRate);
+      }
+   }
+   epicsSocketDestroy(sock);
+}
+
+static void simUsage()
+{
+   printf(
+"Usage: arcusSim [options]\n"
+"  -m pmx|eth|ksa  controller to simulate (default eth)\n"
+"  -p port         TCP port to listen on (default 5001)\n"
+"  -n drives       DMX-K-SA drives on the line (default 1, max %d)\n"
+"  -l ms           reply latency (default 0)\n"
+"  -j ms           extra random reply delay, up to this (default 0)\n"
+"  -d fraction     replies dropped\n"
+"  -g fraction     replies cut short, terminator and all\n"
+"  -r fraction     commands rejected with '?'\n"
+"  -c fraction     commands after which the connection is closed\n"
+"  -e              send replies with no terminator (DMX-ETH quirk)\n"
+"  -L pulses       limit switches at +/- pulses (default none)\n"
+"  -t ms           pulse the latch inputs every ms (default never)\n"
+"  -s seed         random seed, for repeatable fault patterns (default 1)\n",
+      SIM_MAX_AXES);
+}
+
+int main(int argc, char *argv[])
+{
+   osiSockAddr    addr;
+   osiSocklen_t   addrLen;
+   SOCKET         listenSock, sock;
+   const char     *opt, *arg;
+   int            i;
+
+   cfg.model = SIM_DMX_ETH;
+   cfg.port  = 5001;
+   cfg.nAxes = 1;
+   cfg.seed  = 1;
+   for(i = 1; i < argc; i++)
+   {
+      opt = argv[i];
+      if((opt[0] != '-') || !opt[1] || opt[2])
+      {
+         simUsage();
+         return(1);
+      }
+      if((opt[1] == 'e') || (opt[1] == 'h'))
+      {
+         if(opt[1] == 'h')
+         {
+            simUsage();
+            return(0);
+         }
+         cfg.noEos = true;
+         continue;
+      }
+      if(++i >= argc)
+      {
+         simUsage();
+         return(1);
+      }
+      arg = argv[i];
+      switch(opt[1])
+      {
+         case 'm':
+            if(!strcmp(arg, "pmx"))
+               cfg.model = SIM_PMX_4ET_SA;
+            else if(!strcmp(arg, "eth"))
+               cfg.model = SIM_DMX_ETH;
+            else if(!strcmp(arg, "ksa"))
+               cfg.model = SIM_DMX_K_SA;
+            else
+            {
+               simUsage();
+               return(1);
+            }
+            break;
+         case 'p': cfg.port       = atoi(arg);         break;
+         case 'n': cfg.nAxes      = atoi(arg);         break;
+         case 'l': cfg.latency    = atof(arg) / 1000.0; break;
+         case 'j': cfg.jitter     = atof(arg) / 1000.0; break;
+         case 'd': cfg.dropRate   = atof(arg);         break;
+         case 'g': cfg.garbleRate = atof(arg);         break;
+         case 'r': cfg.rejectRate = atof(arg);         break;
+         case 'c': cfg.closeRate  = atof(arg);         break;
+         case 'L': cfg.limit      = atof(arg);         break;
+         case 't': cfg.latchPeriod = atof(arg) / 1000.0; break;
+         case 's': cfg.seed       = (unsigned)atol(arg); break;
+         default:
+            simUsage();
+            return(1);
+      }
+   }
+   if(cfg.model == SIM_PMX_4ET_SA)
+      cfg.nAxes = 4;
+   else if(cfg.model == SIM_DMX_ETH)
+      cfg.nAxes = 1;
+   if((cfg.nAxes < 1) || (cfg.nAxes > SIM_MAX_AXES))
+   {
+      simUsage();
+      return(1);
+   }
+
+   srand(cfg.seed);
+   for(i = 0; i < cfg.nAxes; i++)
+   {
+      axes[i].hspd = 1000;
+      axes[i].lspd = 100;
+      axes[i].acc  = 300;
+   }
+   simLock = epicsMutexMustCreate();
+   epicsTimeGetCurrent(&lastUpdate);
+
+   if(!osiSockAttach())
+   {
+      fprintf(stderr, "arcusSim: no sockets\n");
+      return(1);
+   }
+   listenSock = epicsSocketCreate(AF_INET, SOCK_STREAM, 0);
+   if(listenSock == INVALID_SOCKET)
+   {
+      fprintf(stderr, "arcusSim: can't create socket\n");
+      return(1);
+   }
+   epicsSocketEnableAddressReuseDuringTimeWaitState(listenSock);
+   memset(&addr, 0, sizeof(addr));
+   addr.ia.sin_family      = AF_INET;
+   addr.ia.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.ia.sin_port        = htons((unsigned short)cfg.port);
+   if((bind(listenSock, &addr.sa, sizeof(addr.ia)) != 0) ||
+      (listen(listenSock, 5) != 0))
+   {
+      fprintf(stderr, "arcusSim: can't listen on port %d\n", cfg.port);
+      epicsSocketDestroy(listenSock);
+      return(1);
+   }
+   printf("arcusSim: %s with %d axes on 127.0.0.1:%d\n",
+      simIdStrings[cfg.model], cfg.nAxes, cfg.port);
+
+   for(;;)
+   {
+      addrLen = sizeof(addr);
+      sock = epicsSocketAccept(listenSock, &addr.sa, &addrLen);
+      if(sock == INVALID_SOCKET)
+         continue;
+      epicsThreadCreate("arcusSimClient", epicsThreadPriorityMedium,
+         epicsThreadGetStackSize(epicsThreadStackSmall), simClient,
+         (void *)(size_t)sock);
+   }
+   return(0);
+}